@@ -13,13 +13,39 @@
 #include <tuple>
 #include <optional>
 #include <numeric>
+#include <cmath>
+#include <limits>
+#include <span>
+#include <initializer_list>
+#include <type_traits>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <charconv>
+#include <string_view>
+#include <bit>
+#include <random>
+#include <queue>
+#include <mutex>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace semo {
 
 
 	class mesh;
-	void make_c2f_from_f2c(mesh& msh);
-	void make_c2v_from_c2f_f2v(mesh& msh);
+	void make_f2p_from_patches(mesh& msh);
 
 
 	// trim from left 
@@ -54,1085 +80,4217 @@ namespace semo {
 	}
 
 
-	using pos_t = std::vector<std::array<double, 3>>;
-	using f2v_t = std::vector<std::vector<size_t>>;
-	using f2c_t = std::vector<std::vector<size_t>>;
-	using c2v_t = std::vector<std::vector<size_t>>;
-	using c2f_t = std::vector<std::vector<size_t>>;
+	//===================================================
+	// number of worker threads used by the parallel helpers
+	std::size_t num_threads() {
+		std::size_t n = std::thread::hardware_concurrency();
+		return n == 0 ? 1 : n;
+	}
 
-	using load_t = std::function<void(mesh& m)>; //std::tuple<pos_t, f2v_t>;
-	using save_t = std::function<void(mesh& m)>;
+	// splits [begin, end) into one contiguous block per thread and calls func(block_begin, block_end)
+	template<typename Func>
+	void parallel_for(std::size_t begin, std::size_t end, Func&& func, std::size_t grain = 4096) {
+		if (end <= begin) return;
+		std::size_t n = end - begin;
+		std::size_t num_blocks = std::min(num_threads(), (n + grain - 1) / grain);
+		if (num_blocks <= 1) {
+			func(begin, end);
+			return;
+		}
+		std::vector<std::thread> threads;
+		threads.reserve(num_blocks - 1);
+		std::size_t block = (n + num_blocks - 1) / num_blocks;
+		for (std::size_t b = 1; b < num_blocks; ++b) {
+			std::size_t b0 = begin + b * block;
+			std::size_t b1 = std::min(end, b0 + block);
+			if (b0 >= b1) break;
+			threads.emplace_back([&func, b0, b1]() { func(b0, b1); });
+		}
+		func(begin, std::min(end, begin + block));
+		for (auto& t : threads) t.join();
+	}
 
 
-	class mesh {
+	//===================================================
+	// whitespace separated token scanner over a character buffer
+	class text_scanner {
 	public:
-		pos_t pos;
-		f2v_t f2v;
-		f2c_t f2c;
-		c2v_t c2v;
-		c2f_t c2f;
+		text_scanner(const char* begin, const char* end) : p_(begin), end_(end) {}
 
-		mesh& operator<<(const std::optional<load_t>& mesh_io) { // Լ 
-			if (!mesh_io.has_value()) {
-				std::cout << "mesh_io is nullptr" << std::endl;
-				return *this;
-			}
-			mesh_io.value()(*this);
-			//auto& [pos_io, f2v_io] = mesh_io.value();
-			//this->pos = std::move(pos_io);
-			//this->f2v = std::move(f2v_io);
+		static bool is_space(char c) {
+			return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\v';
+		}
 
-			return *this;
+		void skip_space() {
+			while (p_ != end_ && is_space(*p_)) ++p_;
+		}
+		bool eof() {
+			skip_space();
+			return p_ == end_;
+		}
+		// next run of non-space characters, empty at end of buffer
+		std::string_view next_token() {
+			skip_space();
+			const char* b = p_;
+			while (p_ != end_ && !is_space(*p_)) ++p_;
+			return std::string_view(b, p_ - b);
+		}
+		// next number, locale independent (std::from_chars)
+		template<typename T>
+		bool parse(T& value) {
+			skip_space();
+			if (p_ != end_ && *p_ == '+') ++p_;
+			auto [ptr, ec] = std::from_chars(p_, end_, value);
+			if (ec != std::errc()) return false;
+			p_ = ptr;
+			return true;
+		}
+		void skip_line() {
+			while (p_ != end_ && *p_ != '\n') ++p_;
+			if (p_ != end_) ++p_;
 		}
 
+		const char* position() const { return p_; }
+		const char* end() const { return end_; }
+		void seek(const char* p) { p_ = p; }
 
-		mesh& operator>>(const std::optional<save_t>& mesh_io) { // Լ 
-			if (!mesh_io.has_value()) {
-				std::cout << "mesh_io is nullptr" << std::endl;
-				return *this;
-			}
-			mesh_io.value()(*this);
+	private:
+		const char* p_;
+		const char* end_;
+	};
 
-			return *this;
+	// first occurrence of word as a whole token in [begin, end), end if none
+	const char* find_token(const char* begin, const char* end, std::string_view word) {
+		std::string_view text(begin, end - begin);
+		std::size_t at = text.find(word);
+		while (at != std::string_view::npos) {
+			bool front = at == 0 || text_scanner::is_space(text[at - 1]);
+			bool back = at + word.size() == text.size() || text_scanner::is_space(text[at + word.size()]);
+			if (front && back) return begin + at;
+			at = text.find(word, at + 1);
 		}
+		return end;
+	}
 
-	};
 
+	// parses every number in [begin, end) into out, splitting the text across threads
+	template<typename T>
+	bool parse_numbers(const char* begin, const char* end, std::vector<T>& out) {
+		constexpr std::size_t min_block_bytes = 1 << 20;
+		std::size_t num_blocks = std::max<std::size_t>(1,
+			std::min(num_threads(), static_cast<std::size_t>(end - begin) / min_block_bytes));
+		std::vector<const char*> cuts(num_blocks + 1, end);
+		cuts[0] = begin;
+		for (std::size_t b = 1; b < num_blocks; ++b) {
+			const char* p = std::max(cuts[b - 1], begin + (end - begin) / num_blocks * b);
+			while (p != end && !text_scanner::is_space(*p)) ++p;
+			cuts[b] = p;
+		}
+		// count tokens per block, then parse each block into its slot
+		std::vector<std::size_t> starts(num_blocks + 1, 0);
+		parallel_for(0, num_blocks, [&](std::size_t b0, std::size_t b1) {
+			for (std::size_t b = b0; b < b1; ++b) {
+				text_scanner scan(cuts[b], cuts[b + 1]);
+				std::size_t n = 0;
+				while (!scan.next_token().empty()) ++n;
+				starts[b + 1] = n;
+			}
+			}, 1);
+		for (std::size_t b = 0; b < num_blocks; ++b) starts[b + 1] += starts[b];
+		out.resize(starts[num_blocks]);
+		std::atomic<bool> ok{ true };
+		parallel_for(0, num_blocks, [&](std::size_t b0, std::size_t b1) {
+			for (std::size_t b = b0; b < b1; ++b) {
+				text_scanner scan(cuts[b], cuts[b + 1]);
+				for (std::size_t i = starts[b]; i < starts[b + 1]; ++i) {
+					if (!scan.parse(out[i])) {
+						ok = false;
+						return;
+					}
+				}
+			}
+			}, 1);
+		return ok;
+	}
+
+	// num_blocks + 1 cut points of [begin, end), each block starting at a line start
+	std::vector<const char*> split_at_lines(const char* begin, const char* end, std::size_t num_blocks) {
+		std::vector<const char*> cuts(num_blocks + 1, end);
+		cuts[0] = begin;
+		std::size_t size = end - begin;
+		for (std::size_t b = 1; b < num_blocks; ++b) {
+			const char* p = std::max(cuts[b - 1], begin + size / num_blocks * b);
+			p = std::find(p, end, '\n');
+			cuts[b] = p == end ? end : p + 1;
+		}
+		return cuts;
+	}
 
-	class mesh_io_base {
-	public:
-		virtual load_t load(std::string fileName) = 0;
-		virtual save_t save(std::string filename) = 0;
-	};
 
-	class stl_mesh_io : public mesh_io_base {
+	//===================================================
+	// read-only memory mapped file
+	class mapped_file {
 	public:
-		load_t load(std::string fileName) override {
-
+		mapped_file() = default;
+		explicit mapped_file(const std::filesystem::path& path) { open(path); }
+		~mapped_file() { close(); }
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		bool open(const std::filesystem::path& path) {
+			close();
+#ifdef _WIN32
+			file_ = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ,
+				nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file_ == INVALID_HANDLE_VALUE) return false;
+			LARGE_INTEGER file_size;
+			if (!GetFileSizeEx(file_, &file_size)) { close(); return false; }
+			size_ = static_cast<std::size_t>(file_size.QuadPart);
+			if (size_ == 0) return true;
+			mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping_ == nullptr) { close(); return false; }
+			data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+			if (data_ == nullptr) { close(); return false; }
+#else
+			fd_ = ::open(path.c_str(), O_RDONLY);
+			if (fd_ < 0) return false;
+			struct stat st;
+			if (fstat(fd_, &st) != 0) { close(); return false; }
+			size_ = static_cast<std::size_t>(st.st_size);
+			if (size_ == 0) return true;
+			void* ptr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+			if (ptr == MAP_FAILED) { close(); return false; }
+			data_ = static_cast<const char*>(ptr);
+			madvise(ptr, size_, MADV_SEQUENTIAL);
+#endif
+			return true;
+		}
 
-			load_t load_func;
+		void close() {
+#ifdef _WIN32
+			if (data_) UnmapViewOfFile(data_);
+			if (mapping_) CloseHandle(mapping_);
+			if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+			mapping_ = nullptr;
+			file_ = INVALID_HANDLE_VALUE;
+#else
+			if (data_) munmap(const_cast<char*>(data_), size_);
+			if (fd_ >= 0) ::close(fd_);
+			fd_ = -1;
+#endif
+			data_ = nullptr;
+			size_ = 0;
+		}
 
-			load_func = [fileName](mesh& msh) {
+		bool is_open() const {
+#ifdef _WIN32
+			return file_ != INVALID_HANDLE_VALUE;
+#else
+			return fd_ >= 0;
+#endif
+		}
+		const char* data() const { return data_; }
+		std::size_t size() const { return size_; }
 
+	private:
+		const char* data_ = nullptr;
+		std::size_t size_ = 0;
+#ifdef _WIN32
+		HANDLE file_ = INVALID_HANDLE_VALUE;
+		HANDLE mapping_ = nullptr;
+#else
+		int fd_ = -1;
+#endif
+	};
 
-				//   
-				std::filesystem::path file_path(fileName);
 
-				std::ifstream input_file(file_path, std::ios::in);
-				if (!input_file) {
-					std::cerr << "Error: Cannot open file " << file_path << '\n';
+	//===================================================
+	// output file written through one large reusable buffer
+	class buffered_writer {
+	public:
+		explicit buffered_writer(const std::filesystem::path& path, std::size_t capacity = std::size_t(1) << 22)
+			: file_(path, std::ios::out | std::ios::binary), buffer_(capacity) {}
+		~buffered_writer() { flush(); }
+		buffered_writer(const buffered_writer&) = delete;
+		buffered_writer& operator=(const buffered_writer&) = delete;
+
+		bool is_open() const { return file_.is_open(); }
+		bool good() const { return file_.good(); }
+
+		void write(const void* data, std::size_t n) {
+			if (size_ + n > buffer_.size()) {
+				flush();
+				if (n > buffer_.size()) {
+					file_.write(static_cast<const char*>(data), static_cast<std::streamsize>(n));
 					return;
 				}
+			}
+			std::memcpy(buffer_.data() + size_, data, n);
+			size_ += n;
+		}
+		void write(std::string_view text) { write(text.data(), text.size()); }
+		void put(char c) {
+			if (size_ == buffer_.size()) flush();
+			buffer_[size_++] = c;
+		}
+		// raw bytes of a trivially copyable value
+		template<typename T>
+		void write_value(const T& value) { write(&value, sizeof(T)); }
+
+		// text form of a number, std::to_chars (shortest round trip unless precision is given)
+		template<typename T>
+		void write_number(T value) {
+			reserve_chars(max_number_chars);
+			auto [ptr, ec] = std::to_chars(buffer_.data() + size_, buffer_.data() + buffer_.size(), value);
+			size_ = ptr - buffer_.data();
+		}
+		template<typename T>
+		void write_number(T value, std::chars_format fmt, int precision) {
+			reserve_chars(max_number_chars);
+			auto [ptr, ec] = std::to_chars(buffer_.data() + size_, buffer_.data() + buffer_.size(), value, fmt, precision);
+			size_ = ptr - buffer_.data();
+		}
 
-				char buf[6]{};
-				buf[5] = 0;
-				input_file.read(buf, 5);
-				const std::string asciiHeader = "solid";
-
-				// ascii  б
-				if (std::string(buf) == asciiHeader) {
-					input_file.seekg(0, std::ios::beg);
-					std::string s0, s1;
-					while (!input_file.eof()) {
-						input_file >> s0;
-						if (s0 == "facet") {
-							double x_temp, y_temp, z_temp;
-							double x_avg = 0.0, y_avg = 0.0, z_avg = 0.0;
-							input_file >> s1 >> x_temp >> y_temp >> z_temp;
-							input_file >> s0 >> s1;
-
-							msh.f2v.push_back({});
-
-							input_file >> s0 >> x_temp >> y_temp >> z_temp;
-							msh.pos.push_back({ x_temp, y_temp, z_temp });
-							msh.f2v.back().push_back(msh.pos.size() - 1);
-
-							input_file >> s0 >> x_temp >> y_temp >> z_temp;
-							msh.pos.push_back({ x_temp, y_temp, z_temp });
-							msh.f2v.back().push_back(msh.pos.size() - 1);
-
-							input_file >> s0 >> x_temp >> y_temp >> z_temp;
-							msh.pos.push_back({ x_temp, y_temp, z_temp });
-							msh.f2v.back().push_back(msh.pos.size() - 1);
-
-							input_file >> s0;
-							input_file >> s0;
+		void flush() {
+			if (size_ > 0) {
+				file_.write(buffer_.data(), static_cast<std::streamsize>(size_));
+				size_ = 0;
+			}
+		}
+		void close() {
+			flush();
+			file_.close();
+		}
 
-						}
-						else if (s0 == "endsolid") {
-							break;
-						}
+	private:
+		static constexpr std::size_t max_number_chars = 64;
+		void reserve_chars(std::size_t n) {
+			if (size_ + n > buffer_.size()) flush();
+		}
 
-					}
-				}
-				// binary  б
-				else {
-					input_file.close();
-					input_file.open(file_path, std::ios::in | std::ios::binary);
-
-					// STL   ǳʶٱ
-					char header[80];
-					input_file.read(header, 80);
-
-					// ﰢ   б
-					uint32_t num_triangles = 0;
-					input_file.read(reinterpret_cast<char*>(&num_triangles), sizeof(uint32_t));
-
-					for (size_t idx = 0; idx < num_triangles; ++idx) {
-
-						float normal_t[3], vertex1_t[3], vertex2_t[3], vertex3_t[3];
-						uint16_t attribute;
-						input_file.read(reinterpret_cast<char*>(normal_t), sizeof(float) * 3);
-						input_file.read(reinterpret_cast<char*>(vertex1_t), sizeof(float) * 3);
-						input_file.read(reinterpret_cast<char*>(vertex2_t), sizeof(float) * 3);
-						input_file.read(reinterpret_cast<char*>(vertex3_t), sizeof(float) * 3);
-						input_file.read(reinterpret_cast<char*>(&attribute), sizeof(uint16_t));
-
-						std::array<double, 3> normal;
-						std::array<double, 3> vertex1, vertex2, vertex3;
-						for (size_t i = 0; i < 3; ++i) {
-							normal[i] = static_cast<double>(normal_t[i]);
-							vertex1[i] = static_cast<double>(vertex1_t[i]);
-							vertex2[i] = static_cast<double>(vertex2_t[i]);
-							vertex3[i] = static_cast<double>(vertex3_t[i]);
-						}
-						msh.f2v.push_back({});
-						msh.pos.push_back({ vertex1[0], vertex1[1], vertex1[2] });
-						msh.f2v.back().push_back(msh.pos.size() - 1);
-						msh.pos.push_back({ vertex2[0], vertex2[1], vertex2[2] });
-						msh.f2v.back().push_back(msh.pos.size() - 1);
-						msh.pos.push_back({ vertex3[0], vertex3[1], vertex3[2] });
-						msh.f2v.back().push_back(msh.pos.size() - 1);
-					}
-				}
+		std::ofstream file_;
+		std::vector<char> buffer_;
+		std::size_t size_ = 0;
+	};
 
-				//  ݱ
-				input_file.close();
 
-				std::cout << "Complete Load STL mesh from " << fileName << std::endl;
+	//===================================================
+	// base64 encoding streamed into a buffered_writer
+	class base64_encoder {
+	public:
+		explicit base64_encoder(buffered_writer& out) : out_(out) {}
+		~base64_encoder() { finish(); }
+
+		void write(const void* data, std::size_t n) {
+			auto bytes = static_cast<const unsigned char*>(data);
+			for (std::size_t i = 0; i < n; ++i) {
+				pending_[num_pending_++] = bytes[i];
+				if (num_pending_ == 3) encode_pending();
+			}
+		}
+		template<typename T>
+		void write_value(const T& value) { write(&value, sizeof(T)); }
 
+		// pads the last group; the encoder can be reused afterwards
+		void finish() {
+			if (num_pending_ > 0) encode_pending();
+		}
 
+	private:
+		void encode_pending() {
+			static constexpr char table[] =
+				"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			unsigned char b0 = pending_[0];
+			unsigned char b1 = num_pending_ > 1 ? pending_[1] : 0;
+			unsigned char b2 = num_pending_ > 2 ? pending_[2] : 0;
+			char chars[4] = {
+				table[b0 >> 2],
+				table[((b0 & 0x03) << 4) | (b1 >> 4)],
+				num_pending_ > 1 ? table[((b1 & 0x0f) << 2) | (b2 >> 6)] : '=',
+				num_pending_ > 2 ? table[b2 & 0x3f] : '=' };
+			out_.write(chars, 4);
+			num_pending_ = 0;
+		}
 
-			};
+		buffered_writer& out_;
+		unsigned char pending_[3]{};
+		int num_pending_ = 0;
+	};
 
-			return load_func;
 
+	// decodes num_bytes bytes of base64 text starting at begin (whitespace is skipped);
+	// returns the position after the last 4 character group used, nullptr on bad input
+	const char* base64_decode(const char* begin, const char* end, std::size_t num_bytes, unsigned char* out) {
+		static const auto table = []() {
+			std::array<signed char, 256> t{};
+			t.fill(-1);
+			const char* chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			for (int i = 0; i < 64; ++i) t[static_cast<unsigned char>(chars[i])] = static_cast<signed char>(i);
+			return t;
+			}();
+		const char* p = begin;
+		std::size_t written = 0;
+		while (written < num_bytes) {
+			int group[4];
+			int num_chars = 0;
+			int num_pad = 0;
+			while (num_chars < 4) {
+				if (p == end) return nullptr;
+				char c = *p++;
+				if (text_scanner::is_space(c)) continue;
+				if (c == '=') {
+					group[num_chars++] = 0;
+					++num_pad;
+					continue;
+				}
+				int v = table[static_cast<unsigned char>(c)];
+				if (v < 0 || num_pad > 0) return nullptr;
+				group[num_chars++] = v;
+			}
+			unsigned char bytes[3] = {
+				static_cast<unsigned char>((group[0] << 2) | (group[1] >> 4)),
+				static_cast<unsigned char>(((group[1] & 0x0f) << 4) | (group[2] >> 2)),
+				static_cast<unsigned char>(((group[2] & 0x03) << 6) | group[3]) };
+			for (int i = 0; i < 3 - num_pad && written < num_bytes; ++i) {
+				out[written++] = bytes[i];
+			}
+			if (num_pad > 0 && written < num_bytes) return nullptr;
 		}
-		save_t save(std::string filename) override {
-
-			save_t save_func;
+		return p;
+	}
 
-			save_func = [filename](mesh& mesh) {
 
+	// converts n raw values of type Src at data into out, reversing the bytes
+	// of each value first when swap is set (other endianness)
+	template<typename Src>
+	Src decode_value(const unsigned char* data, bool swap) {
+		unsigned char bytes[sizeof(Src)];
+		std::memcpy(bytes, data, sizeof(Src));
+		if (swap) std::reverse(bytes, bytes + sizeof(Src));
+		Src v;
+		std::memcpy(&v, bytes, sizeof(Src));
+		return v;
+	}
 
-			};
+	template<typename Src, typename Out>
+	void convert_values(const unsigned char* data, std::size_t n, bool swap, Out* out) {
+		// same width and kind (e.g. 32 bit labels into 32 bit indices) : plain copy
+		if constexpr (sizeof(Src) == sizeof(Out) && std::is_integral_v<Src> == std::is_integral_v<Out>) {
+			if (!swap) {
+				parallel_for(0, n, [&](std::size_t i0, std::size_t i1) {
+					std::memcpy(out + i0, data + i0 * sizeof(Src), (i1 - i0) * sizeof(Src));
+					});
+				return;
+			}
+		}
+		parallel_for(0, n, [&](std::size_t i0, std::size_t i1) {
+			for (std::size_t i = i0; i < i1; ++i) {
+				out[i] = static_cast<Out>(decode_value<Src>(data + i * sizeof(Src), swap));
+			}
+			});
+	}
 
-			std::cout << "Saving STL mesh to " << std::endl;
 
-			return save_func;
+	//===================================================
+	// XML tag scanner for large data files : tags are visited in order and
+	// element content is only touched when asked for (no DOM is built)
+	struct xml_tag {
+		std::string_view name;
+		std::string_view attributes;
+		bool closing = false;       // </name>
+		bool self_closing = false;  // <name ... />
+		const char* end = nullptr;  // one past '>'
+
+		// attribute value without quotes, empty if missing
+		std::string_view attribute(std::string_view key) const {
+			std::size_t at = 0;
+			while ((at = attributes.find(key, at)) != std::string_view::npos) {
+				bool front = at == 0 || text_scanner::is_space(attributes[at - 1]);
+				std::size_t q = at + key.size();
+				while (q < attributes.size() && text_scanner::is_space(attributes[q])) ++q;
+				if (front && q < attributes.size() && attributes[q] == '=') {
+					++q;
+					while (q < attributes.size() && text_scanner::is_space(attributes[q])) ++q;
+					if (q < attributes.size() && (attributes[q] == '"' || attributes[q] == '\'')) {
+						std::size_t close = attributes.find(attributes[q], q + 1);
+						if (close == std::string_view::npos) return {};
+						return attributes.substr(q + 1, close - q - 1);
+					}
+				}
+				at += key.size();
+			}
+			return {};
 		}
 	};
 
-	class obj_mesh_io : public mesh_io_base {
+	class xml_scanner {
 	public:
-		load_t load(std::string fileName) override {
-
-			load_t load_func;
+		xml_scanner(const char* begin, const char* end) : p_(begin), end_(end) {}
+
+		// moves to the next element tag, skipping declarations and comments
+		bool next(xml_tag& tag) {
+			while (true) {
+				p_ = std::find(p_, end_, '<');
+				if (p_ == end_) return false;
+				std::string_view rest(p_, end_ - p_);
+				if (rest.starts_with("<?")) {
+					p_ = skip_past(p_, "?>");
+					continue;
+				}
+				if (rest.starts_with("<!--")) {
+					p_ = skip_past(p_, "-->");
+					continue;
+				}
+				if (rest.starts_with("<!")) {
+					p_ = skip_past(p_, ">");
+					continue;
+				}
 
-			load_func = [fileName](mesh& msh) {
+				const char* q = p_ + 1;
+				tag.closing = q != end_ && *q == '/';
+				if (tag.closing) ++q;
+				const char* name = q;
+				while (q != end_ && !text_scanner::is_space(*q) && *q != '/' && *q != '>') ++q;
+				tag.name = std::string_view(name, q - name);
+
+				// closing '>' outside quoted attribute values
+				const char* gt = q;
+				char quote = 0;
+				while (gt != end_ && (quote != 0 || *gt != '>')) {
+					if (quote == 0 && (*gt == '"' || *gt == '\'')) quote = *gt;
+					else if (quote != 0 && *gt == quote) quote = 0;
+					++gt;
+				}
+				if (gt == end_) return false;
+				tag.self_closing = *(gt - 1) == '/';
+				tag.attributes = std::string_view(q, (tag.self_closing ? gt - 1 : gt) - q);
+				tag.end = gt + 1;
+				p_ = tag.end;
+				return true;
+			}
+		}
 
-				std::cout << "Loading OBJ mesh from " << std::endl;
+		const char* position() const { return p_; }
+		void seek(const char* p) { p_ = p; }
 
+	private:
+		const char* skip_past(const char* p, std::string_view marker) const {
+			std::string_view rest(p, end_ - p);
+			std::size_t at = rest.find(marker);
+			return at == std::string_view::npos ? end_ : p + at + marker.size();
+		}
 
-			};
+		const char* p_;
+		const char* end_;
+	};
 
-			return load_func;
 
+	//===================================================
+	// stamps for cache validation, unique over the whole program
+	std::uint64_t next_revision() {
+		static std::atomic<std::uint64_t> counter{ 0 };
+		return ++counter;
+	}
 
 
+	//===================================================
+	// compressed sparse row (CSR) connectivity storage
+	// row i is indices[offsets[i]] ... indices[offsets[i+1]-1]
+	template<typename T>
+	class csr_array {
+	public:
+		using value_type = T;
+		using row_type = std::span<T>;
+		using const_row_type = std::span<const T>;
+
+		template<bool Const>
+		class row_iterator {
+		public:
+			using owner_type = std::conditional_t<Const, const csr_array, csr_array>;
+			using value_type = std::conditional_t<Const, const_row_type, row_type>;
+			using reference = value_type;
+			using difference_type = std::ptrdiff_t;
+			using iterator_category = std::input_iterator_tag;
+
+			row_iterator() = default;
+			row_iterator(owner_type* owner, std::size_t i) : owner_(owner), i_(i) {}
+
+			value_type operator*() const { return (*owner_)[i_]; }
+			row_iterator& operator++() { ++i_; return *this; }
+			row_iterator operator++(int) { auto tmp = *this; ++i_; return tmp; }
+			bool operator==(const row_iterator& other) const { return i_ == other.i_; }
+			bool operator!=(const row_iterator& other) const { return i_ != other.i_; }
+
+		private:
+			owner_type* owner_ = nullptr;
+			std::size_t i_ = 0;
+		};
+		using iterator = row_iterator<false>;
+		using const_iterator = row_iterator<true>;
+
+		csr_array() : offsets_{ 0 } {}
+		csr_array(const csr_array& other)
+			: offsets_(other.offsets_), indices_(other.indices_), revision_(other.revision_.load()) {}
+		csr_array(csr_array&& other) noexcept
+			: offsets_(std::move(other.offsets_)), indices_(std::move(other.indices_)), revision_(other.revision_.load()) {
+			other.touch();
+		}
+		csr_array& operator=(const csr_array& other) {
+			offsets_ = other.offsets_;
+			indices_ = other.indices_;
+			revision_ = other.revision_.load();
+			return *this;
+		}
+		csr_array& operator=(csr_array&& other) noexcept {
+			offsets_ = std::move(other.offsets_);
+			indices_ = std::move(other.indices_);
+			revision_ = other.revision_.load();
+			other.touch();
+			return *this;
 		}
-		save_t save(std::string fileName) override {
-			save_t save_func;
-
-			save_func = [fileName](mesh& msh) {
-				std::ofstream file(fileName);
-				if (!file.is_open()) {
-					std::cerr << "   ϴ." << std::endl;
-					return;
-				}
-
-				for (const auto& v : msh.pos) {
-					file << "v " << v[0] << " " << v[1] << " " << v[2] << std::endl;
-				}
-				for (const auto& v : msh.f2v) {
-					file << "f " << v[0] + 1 << " " << v[1] + 1 << " " << v[2] + 1 << std::endl;
-				}
-
-				file.close();
-				std::cout << "  Ǿϴ." << std::endl;
 
-			};
+		// identifies the current contents : changes after any call below that can
+		// modify them (rows written in place through operator[] are not seen);
+		// copies share the revision of their source
+		std::uint64_t revision() const {
+			std::uint64_t r = revision_.load(std::memory_order_relaxed);
+			if (r == 0) {
+				std::uint64_t fresh = next_revision();
+				if (revision_.compare_exchange_strong(r, fresh)) r = fresh;
+			}
+			return r;
+		}
 
+		// number of rows
+		std::size_t size() const { return offsets_.size() - 1; }
+		bool empty() const { return size() == 0; }
+		// number of stored indices over all rows
+		std::size_t num_entries() const { return indices_.size(); }
 
+		row_type operator[](std::size_t i) {
+			return row_type(indices_.data() + offsets_[i], offsets_[i + 1] - offsets_[i]);
+		}
+		const_row_type operator[](std::size_t i) const {
+			return const_row_type(indices_.data() + offsets_[i], offsets_[i + 1] - offsets_[i]);
+		}
+		row_type back() { return (*this)[size() - 1]; }
+		const_row_type back() const { return (*this)[size() - 1]; }
+
+		iterator begin() { return iterator(this, 0); }
+		iterator end() { return iterator(this, size()); }
+		const_iterator begin() const { return const_iterator(this, 0); }
+		const_iterator end() const { return const_iterator(this, size()); }
+
+		// append a row
+		void push_back(std::initializer_list<T> row) {
+			touch();
+			indices_.insert(indices_.end(), row.begin(), row.end());
+			offsets_.push_back(indices_.size());
+		}
+		template<typename Range>
+		void push_back(const Range& row) {
+			touch();
+			indices_.insert(indices_.end(), std::begin(row), std::end(row));
+			offsets_.push_back(indices_.size());
+		}
+		// append an empty row, filled afterwards with append_to_back
+		void emplace_back() {
+			touch();
+			offsets_.push_back(indices_.size());
+		}
+		void append_to_back(T value) {
+			touch();
+			indices_.push_back(value);
+			++offsets_.back();
+		}
 
-			std::cout << "Saving OBJ mesh to " << std::endl;
-			return save_func;
+		void reserve(std::size_t num_rows, std::size_t num_entries) {
+			offsets_.reserve(num_rows + 1);
+			indices_.reserve(num_entries);
+		}
+		void clear() {
+			touch();
+			offsets_.assign(1, 0);
+			indices_.clear();
 		}
-	};
 
+		// append num_rows rows of the same width, indices left to be filled
+		void append_uniform(std::size_t num_rows, std::size_t width) {
+			touch();
+			std::size_t row0 = size();
+			std::size_t base = indices_.size();
+			offsets_.resize(row0 + num_rows + 1);
+			for (std::size_t i = 1; i <= num_rows; ++i) {
+				offsets_[row0 + i] = base + i * width;
+			}
+			indices_.resize(base + num_rows * width);
+		}
+		// append rows sized by counts[i], indices left to be filled
+		template<typename Counts>
+		void append_counts(const Counts& counts) {
+			touch();
+			offsets_.reserve(offsets_.size() + std::size(counts));
+			for (auto c : counts) {
+				offsets_.push_back(offsets_.back() + static_cast<std::size_t>(c));
+			}
+			indices_.resize(offsets_.back());
+		}
+		template<typename Counts>
+		void assign_counts(const Counts& counts) {
+			clear();
+			append_counts(counts);
+		}
 
+		std::vector<std::size_t>& offsets() { touch(); return offsets_; }
+		const std::vector<std::size_t>& offsets() const { return offsets_; }
+		std::vector<T>& indices() { touch(); return indices_; }
+		const std::vector<T>& indices() const { return indices_; }
 
+	private:
+		void touch() { revision_.store(0, std::memory_order_relaxed); }
 
+		std::vector<std::size_t> offsets_;
+		std::vector<T> indices_;
+		mutable std::atomic<std::uint64_t> revision_{ 0 };   // 0 : changed, stamped when asked
+	};
 
 
-	class openfoam_mesh_io : public mesh_io_base {
+	//===================================================
+	// point coordinates, stored as Real (float halves the memory of large
+	// scans) either interleaved xyz xyz ... or as separate x, y and z arrays.
+	// A point reads as std::array<double, 3>; pos[i][k] is a component and
+	// pos[i] = { x, y, z } or pos.set(i, x, y, z) writes one.
+	template<typename Real, bool SoA>
+	class point_array {
 	public:
-		load_t load(std::string fileName) override {
-
-			load_t load_func;
-
-			load_func = [fileName](mesh& msh) {
-
-				auto& pos = msh.pos;
-				auto& f2v = msh.f2v;
-				auto& f2c = msh.f2c;
+		using real_type = Real;
+		using value_type = std::array<double, 3>;
+		static constexpr bool soa = SoA;
+		// distance between two values of one component in data(k)
+		static constexpr std::size_t stride = SoA ? 1 : 3;
+
+		template<bool Const>
+		class point_ref {
+		public:
+			using owner_type = std::conditional_t<Const, const point_array, point_array>;
+			using component_type = std::conditional_t<Const, const Real&, Real&>;
+
+			point_ref(owner_type* owner, std::size_t i) : owner_(owner), i_(i) {}
+			point_ref(const point_ref&) = default;
+
+			component_type operator[](int k) const { return owner_->at(i_, k); }
+			operator value_type() const { return owner_->get(i_); }
+
+			// assignment writes the coordinates, it does not rebind
+			const point_ref& operator=(const value_type& p) const requires (!Const) {
+				owner_->set(i_, p[0], p[1], p[2]);
+				return *this;
+			}
+			const point_ref& operator=(const point_ref& other) const requires (!Const) {
+				return *this = static_cast<value_type>(other);
+			}
+			template<bool OtherConst>
+			const point_ref& operator=(const point_ref<OtherConst>& other) const requires (!Const) {
+				return *this = static_cast<value_type>(other);
+			}
 
+		private:
+			owner_type* owner_;
+			std::size_t i_;
+		};
+		using reference = point_ref<false>;
+		using const_reference = point_ref<true>;
+
+		class const_iterator {
+		public:
+			using value_type = point_array::value_type;
+			using reference = value_type;
+			using difference_type = std::ptrdiff_t;
+			using iterator_category = std::input_iterator_tag;
+
+			const_iterator() = default;
+			const_iterator(const point_array* owner, std::size_t i) : owner_(owner), i_(i) {}
+
+			value_type operator*() const { return owner_->get(i_); }
+			const_iterator& operator++() { ++i_; return *this; }
+			const_iterator operator++(int) { auto tmp = *this; ++i_; return tmp; }
+			bool operator==(const const_iterator& other) const { return i_ == other.i_; }
+			bool operator!=(const const_iterator& other) const { return i_ != other.i_; }
+
+		private:
+			const point_array* owner_ = nullptr;
+			std::size_t i_ = 0;
+		};
+
+		point_array() = default;
+		explicit point_array(std::size_t n) { resize(n); }
+
+		std::size_t size() const { return data_[0].size() / stride; }
+		bool empty() const { return data_[0].empty(); }
+
+		reference operator[](std::size_t i) { return reference(this, i); }
+		const_reference operator[](std::size_t i) const { return const_reference(this, i); }
+
+		const_iterator begin() const { return const_iterator(this, 0); }
+		const_iterator end() const { return const_iterator(this, size()); }
+
+		Real& at(std::size_t i, int k) {
+			if constexpr (SoA) return data_[k][i];
+			else return data_[0][3 * i + k];
+		}
+		const Real& at(std::size_t i, int k) const {
+			if constexpr (SoA) return data_[k][i];
+			else return data_[0][3 * i + k];
+		}
+		value_type get(std::size_t i) const {
+			return { static_cast<double>(at(i, 0)), static_cast<double>(at(i, 1)), static_cast<double>(at(i, 2)) };
+		}
+		template<typename X, typename Y, typename Z>
+		void set(std::size_t i, X x, Y y, Z z) {
+			at(i, 0) = static_cast<Real>(x);
+			at(i, 1) = static_cast<Real>(y);
+			at(i, 2) = static_cast<Real>(z);
+		}
 
-				std::string gridFolderName = fileName;
-				std::string pointsName = "points";
-				std::string facesName = "faces";
-				std::string ownerName = "owner";
-				std::string neighbourName = "neighbour";
-				std::string boundaryName = "boundary";
+		// first value of component k, the others follow every stride values
+		// (never touches an element, so it is safe on an empty array)
+		Real* data(int k) {
+			auto& d = data_[SoA ? k : 0];
+			return d.empty() ? d.data() : d.data() + (SoA ? 0 : k);
+		}
+		const Real* data(int k) const {
+			const auto& d = data_[SoA ? k : 0];
+			return d.empty() ? d.data() : d.data() + (SoA ? 0 : k);
+		}
 
-				std::ifstream inputFile;
-				std::string openFileName;
+		void push_back(const value_type& p) {
+			for (int k = 0; k < 3; ++k) data_[SoA ? k : 0].push_back(static_cast<Real>(p[k]));
+		}
+		void resize(std::size_t n) {
+			for (auto& d : data_) d.resize(n * stride);
+		}
+		void reserve(std::size_t n) {
+			for (auto& d : data_) d.reserve(n * stride);
+		}
+		void clear() {
+			for (auto& d : data_) d.clear();
+		}
 
-				// points б
-				openFileName = gridFolderName + "/" + pointsName;
-				inputFile.open(openFileName);
-				if (inputFile.fail()) {
-					std::cerr << "Unable to open file for reading : " << openFileName << std::endl;
-					return;
+		// overwrites points at ... at + src.size() - 1 with src
+		void copy_from(const point_array& src, std::size_t at) {
+			for (std::size_t d = 0; d < data_.size(); ++d) {
+				std::copy(src.data_[d].begin(), src.data_[d].end(), data_[d].begin() + at * stride);
+			}
+		}
+		// points ids[0], ids[1], ... in that order
+		point_array gather(const std::vector<std::size_t>& ids) const {
+			point_array result(ids.size());
+			parallel_for(0, ids.size(), [&](std::size_t i0, std::size_t i1) {
+				for (std::size_t i = i0; i < i1; ++i) {
+					for (int k = 0; k < 3; ++k) result.at(i, k) = at(ids[i], k);
 				}
+				});
+			return result;
+		}
+		// n points from interleaved xyz values
+		template<typename T>
+		void assign_interleaved(const T* xyz, std::size_t n) {
+			resize(n);
+			parallel_for(0, n, [&](std::size_t i0, std::size_t i1) {
+				for (std::size_t i = i0; i < i1; ++i) set(i, xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]);
+				});
+		}
 
-				std::string nextToken;
-				bool startInput = false;
-				while (getline(inputFile, nextToken)) {
-					std::string asignToken;
+	private:
+		std::array<std::vector<Real>, SoA ? 3 : 1> data_;
+	};
 
-					if (startInput) {
-						if (asignToken.assign(nextToken, 0, 1) == ")") {
-							break;
-						}
-						else {
-							std::vector<double> xyz(3, 0.0);
-							nextToken.erase(nextToken.find("("), 1);
-							nextToken.erase(nextToken.find(")"), 1);
-							std::stringstream sstream(nextToken);
-							std::string word;
-							char del = ' ';
-							int num = 0;
-							while (getline(sstream, word, del)) {
-								xyz[num] = stold(word);
-								++num;
-							}
-							pos.push_back({ xyz[0], xyz[1], xyz[2] });
-						}
-					}
-					else {
-						if (asignToken.assign(nextToken, 0, 1) == "(") {
-							startInput = true;
-						}
-					}
+	// storage of mesh points, chosen at compile time :
+	// SEMO_POINT_FLOAT stores single precision, SEMO_POINT_SOA separate x / y / z arrays
+#ifndef SEMO_POINT_FLOAT
+#define SEMO_POINT_FLOAT 0
+#endif
+#ifndef SEMO_POINT_SOA
+#define SEMO_POINT_SOA 0
+#endif
+	using pos_t = point_array<std::conditional_t<SEMO_POINT_FLOAT != 0, float, double>, SEMO_POINT_SOA != 0>;
+
+	// n raw xyz triples of type Src at data into points (see convert_values)
+	template<typename Src, typename Real, bool SoA>
+	void convert_points(const unsigned char* data, std::size_t n, bool swap, point_array<Real, SoA>& points) {
+		points.resize(n);
+		if constexpr (!SoA) {
+			convert_values<Src>(data, 3 * n, swap, points.data(0));
+		}
+		else {
+			parallel_for(0, n, [&](std::size_t i0, std::size_t i1) {
+				for (std::size_t i = i0; i < i1; ++i) {
+					const unsigned char* p = data + 3 * i * sizeof(Src);
+					points.set(i, decode_value<Src>(p, swap), decode_value<Src>(p + sizeof(Src), swap),
+						decode_value<Src>(p + 2 * sizeof(Src), swap));
 				}
-				inputFile.close();
+				});
+		}
+	}
 
+	// point, face and cell numbers stored in the connectivity, chosen at compile
+	// time : SEMO_INDEX_32 stores 32 bit indices (half the memory; loaders
+	// refuse meshes with more entities). Row offsets stay size_t.
+#ifndef SEMO_INDEX_32
+#define SEMO_INDEX_32 0
+#endif
+	using index_t = std::conditional_t<SEMO_INDEX_32 != 0, std::uint32_t, std::size_t>;
+
+	// true when n points, faces or cells can be numbered with index_t
+	bool fits_index(std::size_t n, const char* what) {
+		if (n <= std::numeric_limits<index_t>::max()) return true;
+		std::cerr << "Error: " << n << " " << what << " exceed the " << 8 * sizeof(index_t)
+			<< " bit index range" << std::endl;
+		return false;
+	}
 
+	using f2v_t = csr_array<index_t>;
+	using f2c_t = csr_array<index_t>;
+	using c2v_t = csr_array<index_t>;
+	using c2f_t = csr_array<index_t>;
+	using v2f_t = csr_array<index_t>;
+	using v2c_t = csr_array<index_t>;
+	using v2v_t = csr_array<index_t>;
 
-				// faces б
-				openFileName = gridFolderName + "/" + facesName;
-				inputFile.open(openFileName);
-				if (inputFile.fail()) {
-					std::cerr << "Unable to open file for reading : " << openFileName << std::endl;
-					return;
-				}
-				startInput = false;
-				bool continueInput = false;
-				std::string saveToken;
-				while (getline(inputFile, nextToken)) {
-					std::string asignToken;
+	using load_t = std::function<void(mesh& m)>; //std::tuple<pos_t, f2v_t>;
+	using save_t = std::function<void(mesh& m)>;
 
-					if (startInput) {
-						if (asignToken.assign(nextToken, 0, 1) == ")" && !continueInput) {
-							break;
-						}
-						else {
-							if (nextToken.size() == 1) continue;
-
-							if (nextToken.find(")") == std::string::npos) {
-								saveToken.append(" ");
-								rtrim(nextToken);
-								saveToken.append(nextToken);
-								continueInput = true;
-								continue;
-							}
-							saveToken.append(" ");
-							rtrim(nextToken);
-							saveToken.append(nextToken);
 
-							saveToken.replace(saveToken.find("("), 1, " ");
-							saveToken.replace(saveToken.find(")"), 1, " ");
-							std::istringstream iss(saveToken);
-							size_t tempint;
-							iss >> tempint;
+	//===================================================
+	// transposes a list of rows : row k of the result holds, in increasing
+	// order, every i whose row(i) contains key k (counting sort, parallel)
+	template<typename T, typename RowFunc>
+	csr_array<T> invert_rows(std::size_t num_rows, std::size_t num_keys, RowFunc row) {
+
+		csr_array<T> result;
+		if (num_keys == 0) return result;
+
+		constexpr std::size_t grain = 4096;
+		std::size_t num_blocks = std::max<std::size_t>(1,
+			std::min(num_threads(), (num_rows + grain - 1) / grain));
+		std::size_t block = (num_rows + num_blocks - 1) / std::max<std::size_t>(1, num_blocks);
+		auto block_range = [&](std::size_t b) {
+			return std::make_pair(std::min(num_rows, b * block), std::min(num_rows, (b + 1) * block));
+			};
 
-							f2v.push_back({});
+		// per-thread histograms keep the scatter stable without atomics; they
+		// cost num_blocks * num_keys counters, so they are only used when that
+		// is small next to the data itself
+		std::size_t histogram_size = num_blocks * num_keys;
+		std::size_t data_size = 4 * num_rows;
+		for (std::size_t i = 0; i < num_rows && data_size < histogram_size; ++i) {
+			data_size += 4 * std::size(row(i));
+		}
 
-							while (iss >> tempint) {
-								f2v.back().push_back(tempint);
-							}
-							saveToken.clear();
-							continueInput = false;
-						}
+		std::vector<std::size_t> offsets(num_keys + 1, 0);
+
+		if (num_blocks == 1 || histogram_size <= data_size) {
+			std::vector<std::size_t> hist(num_blocks * num_keys, 0);
+			parallel_for(0, num_blocks, [&](std::size_t b0, std::size_t b1) {
+				for (std::size_t b = b0; b < b1; ++b) {
+					auto [i0, i1] = block_range(b);
+					std::size_t* h = hist.data() + b * num_keys;
+					for (std::size_t i = i0; i < i1; ++i) {
+						for (auto k : row(i)) ++h[k];
 					}
-					else {
-						if (asignToken.assign(nextToken, 0, 1) == "(") {
-							startInput = true;
-						}
+				}
+				}, 1);
+			// hist[b][k] becomes the write cursor of block b for key k
+			for (std::size_t k = 0; k < num_keys; ++k) {
+				std::size_t running = offsets[k];
+				for (std::size_t b = 0; b < num_blocks; ++b) {
+					std::size_t c = hist[b * num_keys + k];
+					hist[b * num_keys + k] = running;
+					running += c;
+				}
+				offsets[k + 1] = running;
+			}
+			std::vector<T> indices(offsets[num_keys]);
+			parallel_for(0, num_blocks, [&](std::size_t b0, std::size_t b1) {
+				for (std::size_t b = b0; b < b1; ++b) {
+					auto [i0, i1] = block_range(b);
+					std::size_t* h = hist.data() + b * num_keys;
+					for (std::size_t i = i0; i < i1; ++i) {
+						for (auto k : row(i)) indices[h[k]++] = static_cast<T>(i);
 					}
 				}
-				inputFile.close();
+				}, 1);
+			result.offsets() = std::move(offsets);
+			result.indices() = std::move(indices);
+			return result;
+		}
 
-
-
-				// owner
-				openFileName = gridFolderName + "/" + ownerName;
-				inputFile.open(openFileName);
-				if (inputFile.fail()) {
-					std::cerr << "Unable to open file for reading : " << openFileName << std::endl;
-					return;
+		// many keys : shared atomic counters, then restore order per key
+		std::vector<std::size_t> counts(num_keys, 0);
+		parallel_for(0, num_rows, [&](std::size_t i0, std::size_t i1) {
+			for (std::size_t i = i0; i < i1; ++i) {
+				for (auto k : row(i)) {
+					std::atomic_ref<std::size_t>(counts[k]).fetch_add(1, std::memory_order_relaxed);
 				}
-				int temp_num = 0;
-				startInput = false;
-				while (getline(inputFile, nextToken)) {
-					std::string asignToken;
-
-					if (startInput) {
-						if (asignToken.assign(nextToken, 0, 1) == ")") {
-							break;
-						}
-						else {
-							std::istringstream iss(nextToken);
-							size_t tempint;
-							while (iss >> tempint) {
-								f2c.push_back({ tempint });
-								++temp_num;
-							}
-						}
-					}
-					else {
-						if (asignToken.assign(nextToken, 0, 1) == "(") {
-							startInput = true;
-						}
-					}
+			}
+			});
+		for (std::size_t k = 0; k < num_keys; ++k) {
+			offsets[k + 1] = offsets[k] + counts[k];
+			counts[k] = offsets[k];
+		}
+		std::vector<T> indices(offsets[num_keys]);
+		parallel_for(0, num_rows, [&](std::size_t i0, std::size_t i1) {
+			for (std::size_t i = i0; i < i1; ++i) {
+				for (auto k : row(i)) {
+					std::size_t at = std::atomic_ref<std::size_t>(counts[k]).fetch_add(1, std::memory_order_relaxed);
+					indices[at] = static_cast<T>(i);
 				}
-				inputFile.close();
-
-
+			}
+			});
+		parallel_for(0, num_keys, [&](std::size_t k0, std::size_t k1) {
+			for (std::size_t k = k0; k < k1; ++k) {
+				std::sort(indices.begin() + offsets[k], indices.begin() + offsets[k + 1]);
+			}
+			});
+		result.offsets() = std::move(offsets);
+		result.indices() = std::move(indices);
+		return result;
+	}
 
+	// transposes a csr_array whose values are smaller than num_keys
+	template<typename T>
+	csr_array<T> invert_csr(const csr_array<T>& src, std::size_t num_keys) {
+		return invert_rows<T>(src.size(), num_keys, [&src](std::size_t i) { return src[i]; });
+	}
 
-				// neighbour
-				openFileName = gridFolderName + "/" + neighbourName;
-				inputFile.open(openFileName);
-				if (inputFile.fail()) {
-					std::cerr << "Unable to open file for reading : " << openFileName << std::endl;
-					return;
-				}
-				temp_num = 0;
-				startInput = false;
-				while (getline(inputFile, nextToken)) {
-					std::string asignToken;
 
-					if (startInput) {
-						if (asignToken.assign(nextToken, 0, 1) == ")") {
-							break;
-						}
-						else {
-							std::istringstream iss(nextToken);
-							int tempint;
-							while (iss >> tempint) {
-								if (tempint < 0) break;
-								f2c[temp_num].push_back(tempint);
-								// mesh.faces[temp_num].thereR = true;
-								//mesh.faces[temp_num].setType(MASCH_Face_Types::INTERNAL);
-								++temp_num;
-							}
-						}
-					}
-					else {
-						if (asignToken.assign(nextToken, 0, 1) == "(") {
-							startInput = true;
-						}
-					}
-				}
-				inputFile.close();
+	// boundary patch owning the faces start_face ... start_face + num_faces - 1
+	// (OpenFOAM keeps the faces of a patch contiguous, and so does every
+	// function here that renumbers faces)
+	struct patch {
+		std::string name;
+		std::string type;
+		size_t start_face = 0;
+		size_t num_faces = 0;
+		int my_proc_no = -1;        // processor patches only
+		int neighb_proc_no = -1;
 
+		size_t end_face() const { return start_face + num_faces; }
+	};
 
+	using f2p_t = std::vector<int32_t>;   // patch index per face, -1 for faces in no patch
 
-				// boundary
-				openFileName = gridFolderName + "/" + boundaryName;
-				inputFile.open(openFileName);
-				if (inputFile.fail()) {
-					std::cerr << "Unable to open file for reading : " << openFileName << std::endl;
-					return;
-				}
-				std::vector<std::string> boundary_name;
-				std::vector<char> boundary_type;
-				std::vector<int> boundary_nFaces;
-				std::vector<int> boundary_startFace;
-				std::vector<int> boundary_myProcNo;
-				std::vector<int> boundary_neighbProcNo;
-
-				std::string backToken;
-				startInput = false;
-				std::vector<std::string> setToken;
-				while (getline(inputFile, nextToken)) {
-					std::string asignToken;
-					if (startInput) {
-						if (asignToken.assign(nextToken, 0, 1) == ")") {
-							break;
-						}
-						setToken.push_back(nextToken.c_str());
-					}
-					else {
-						if (asignToken.assign(nextToken, 0, 1) == "(") {
-							startInput = true;
-						}
-					}
-					backToken = nextToken;
-				}
-
-				std::string names;
-				std::vector<std::string> setToken2;
-				startInput = false;
-				for (auto item : setToken) {
-					std::string asignToken;
-					if (startInput) {
-						if (item.find("}") != std::string::npos) {
-							trim(names);
-
-							boundary_name.push_back(names);
-							int l = 0;
-							for (auto item2 : setToken2) {
-								if (item2.find("nFaces") != std::string::npos) {
-									std::istringstream iss(item2);
-									std::string temptemp;
-									int temptempint;
-									iss >> temptemp >> temptempint;
-									boundary_nFaces.push_back(temptempint);
-								}
-								if (item2.find("startFace") != std::string::npos) {
-									std::istringstream iss(item2);
-									std::string temptemp;
-									int temptempint;
-									iss >> temptemp >> temptempint;
-									boundary_startFace.push_back(temptempint);
-								}
-								if (item2.find("myProcNo") != std::string::npos) {
-									std::istringstream iss(item2);
-									std::string temptemp;
-									int temptempint;
-									iss >> temptemp >> temptempint;
-									boundary_myProcNo.push_back(temptempint);
-									++l;
-								}
-								if (item2.find("neighbProcNo") != std::string::npos) {
-									std::istringstream iss(item2);
-									std::string temptemp;
-									int temptempint;
-									iss >> temptemp >> temptempint;
-									boundary_neighbProcNo.push_back(temptempint);
-									++l;
-								}
-							}
-							if (l == 0) {
-								boundary_myProcNo.push_back(-1);
-								boundary_neighbProcNo.push_back(-1);
-							}
 
-							startInput = false;
-							setToken2.clear();
-						}
-						setToken2.push_back(item.c_str());
-					}
-					else {
-						if (item.find("{") != std::string::npos) {
-							names.clear();
-							names = backToken;
-							startInput = true;
-						}
-					}
-					backToken = item;
-				}
+	// unique edges of a face list, e.g. a surface from STL after unique_vertex
+	struct edge_table {
+		static constexpr std::uint8_t boundary = 1;       // edge of a single face
+		static constexpr std::uint8_t non_manifold = 2;   // edge of more than two faces
 
+		std::vector<std::array<index_t, 2>> e2v;  // smaller point first
+		csr_array<index_t> e2f;                   // faces along every edge, in increasing order
+		csr_array<index_t> f2e;                   // edge i of a face runs from its point i to i + 1
+		csr_array<index_t> f2f;                   // faces sharing an edge, sorted
+		std::vector<std::uint8_t> flags;
 
+		size_t size() const { return e2v.size(); }
+		bool is_boundary(size_t e) const { return flags[e] & boundary; }
+		bool is_non_manifold(size_t e) const { return flags[e] & non_manifold; }
+		// every edge shared by exactly two faces
+		bool watertight() const {
+			return std::all_of(flags.begin(), flags.end(), [](std::uint8_t f) { return f == 0; });
+		}
+	};
 
-				inputFile.close();
-				////mesh.boundaries.clear();
-				//int nbcs = boundary_name.size();
-				//for (int i = 0; i < boundary_name.size(); ++i) {
-				//	mesh.addBoundary();
-				//}
-				//for (int i = 0; i < mesh.boundaries.size(); ++i) {
-				//	mesh.boundaries[i].name = trim(boundary_name[i]);
-				//	mesh.boundaries[i].nFaces = static_cast<int>(boundary_nFaces[i]);
-				//	mesh.boundaries[i].startFace = static_cast<int>(boundary_startFace[i]);
-				//	mesh.boundaries[i].myProcNo = static_cast<int>(boundary_myProcNo[i]);
-				//	mesh.boundaries[i].rightProcNo = static_cast<int>(boundary_neighbProcNo[i]);
-				//	// mesh.boundaries[i].thereR = false;
-				//	mesh.boundaries[i].setType(MASCH_Face_Types::BOUNDARY);
-				//}
+	edge_table make_edge_table(const f2v_t& f2v);
 
 
+	c2f_t make_c2f_from_f2c(const f2c_t& f2c);
+	c2v_t make_c2v_from_c2f_f2v(const c2f_t& c2f, const f2v_t& f2v);
+	v2f_t make_v2f_from_f2v(const f2v_t& f2v, size_t num_points);
+	v2c_t make_v2c_from_c2v(const c2v_t& c2v, size_t num_points);
+	v2v_t make_v2v_from_v2f_f2v(const v2f_t& v2f, const f2v_t& f2v);
 
 
-				make_c2f_from_f2c(msh);
-				make_c2v_from_c2f_f2v(msh);
+	class mesh {
+	public:
+		pos_t pos;
+		f2v_t f2v;
+		f2c_t f2c;
+		std::vector<patch> patches;
+		f2p_t f2p;
+
+		// cell connectivity, derived on first use and cached : c2f from f2c,
+		// c2v from c2f and f2v. A cache is rebuilt once the revision of one of
+		// its sources has changed; call invalidate() after editing f2c or f2v
+		// rows in place. Every cache is rebuilt under its own mutex, so several
+		// threads may ask for it at once while the mesh itself is not edited.
+		const c2f_t& c2f() const {
+			std::array<std::uint64_t, 1> sources{ f2c.revision() };
+			return c2f_.get(sources, [&]() { return make_c2f_from_f2c(f2c); });
+		}
+		const c2v_t& c2v() const {
+			const auto& cell_faces = c2f();
+			std::array<std::uint64_t, 2> sources{ cell_faces.revision(), f2v.revision() };
+			return c2v_.get(sources, [&]() { return make_c2v_from_c2f_f2v(cell_faces, f2v); });
+		}
+		size_t num_cells() const { return c2f().size(); }
 
+		// point adjacency, cached the same way; the number of points counts as a source
+		const v2f_t& v2f() const {
+			std::array<std::uint64_t, 2> sources{ f2v.revision(), pos.size() };
+			return v2f_.get(sources, [&]() { return make_v2f_from_f2v(f2v, pos.size()); });
+		}
+		const v2c_t& v2c() const {
+			const auto& cell_points = c2v();
+			std::array<std::uint64_t, 2> sources{ cell_points.revision(), pos.size() };
+			return v2c_.get(sources, [&]() { return make_v2c_from_c2v(cell_points, pos.size()); });
+		}
+		// points sharing a face edge
+		const v2v_t& v2v() const {
+			const auto& point_faces = v2f();
+			std::array<std::uint64_t, 2> sources{ point_faces.revision(), f2v.revision() };
+			return v2v_.get(sources, [&]() { return make_v2v_from_v2f_f2v(point_faces, f2v); });
+		}
 
-				std::cout << "Loading OBJ mesh from " << std::endl;
+		// connectivity a reader already has (e.g. VTU cells), used instead of
+		// deriving it until the sources change
+		void set_c2f(c2f_t c2f) {
+			std::array<std::uint64_t, 1> sources{ f2c.revision() };
+			c2f_.assign(std::move(c2f), sources);
+		}
+		void set_c2v(c2v_t c2v) {
+			std::array<std::uint64_t, 2> sources{ c2f().revision(), f2v.revision() };
+			c2v_.assign(std::move(c2v), sources);
+		}
+		void invalidate() {
+			c2f_.reset();
+			c2v_.reset();
+			v2f_.reset();
+			v2c_.reset();
+			v2v_.reset();
+		}
 
+		mesh& operator<<(const std::optional<load_t>& mesh_io) { // Լ 
+			if (!mesh_io.has_value()) {
+				std::cout << "mesh_io is nullptr" << std::endl;
+				return *this;
+			}
+			mesh_io.value()(*this);
+			//auto& [pos_io, f2v_io] = mesh_io.value();
+			//this->pos = std::move(pos_io);
+			//this->f2v = std::move(f2v_io);
 
-			};
+			return *this;
+		}
 
-			return load_func;
 
+		mesh& operator>>(const std::optional<save_t>& mesh_io) { // Լ 
+			if (!mesh_io.has_value()) {
+				std::cout << "mesh_io is nullptr" << std::endl;
+				return *this;
+			}
+			mesh_io.value()(*this);
 
+			return *this;
 		}
-		save_t save(std::string fileName) override {
-			save_t save_func;
 
-			save_func = [fileName](mesh& msh) {
-				std::ofstream file(fileName);
-				if (!file.is_open()) {
-					std::cerr << "   ϴ." << std::endl;
-					return;
-				}
+	private:
+		// copies and moves take the cached value, never the mutex
+		template<std::size_t N>
+		struct cached_csr {
+			csr_array<index_t> data;
+			std::array<std::uint64_t, N> sources{};
+			bool valid = false;
+			mutable std::mutex lock;
+
+			cached_csr() = default;
+			cached_csr(const cached_csr& other) { *this = other; }
+			cached_csr(cached_csr&& other) noexcept { *this = std::move(other); }
+			cached_csr& operator=(const cached_csr& other) {
+				if (this == &other) return *this;
+				std::scoped_lock guard(lock, other.lock);
+				data = other.data;
+				sources = other.sources;
+				valid = other.valid;
+				return *this;
+			}
+			cached_csr& operator=(cached_csr&& other) noexcept {
+				if (this == &other) return *this;
+				std::scoped_lock guard(lock, other.lock);
+				data = std::move(other.data);
+				sources = other.sources;
+				valid = other.valid;
+				other.valid = false;
+				return *this;
+			}
 
-				for (const auto& v : msh.pos) {
-					file << "v " << v[0] << " " << v[1] << " " << v[2] << std::endl;
-				}
-				for (const auto& v : msh.f2v) {
-					file << "f " << v[0] + 1 << " " << v[1] + 1 << " " << v[2] + 1 << std::endl;
+			// the cached value, built first when it is missing or its sources changed
+			template<typename Build>
+			const csr_array<index_t>& get(const std::array<std::uint64_t, N>& current, Build build) {
+				std::lock_guard<std::mutex> guard(lock);
+				if (!valid || sources != current) {
+					data = build();
+					sources = current;
+					valid = true;
 				}
-
-				file.close();
-				std::cout << "  Ǿϴ." << std::endl;
-
-			};
-
-
-
-			std::cout << "Saving Openfoam mesh to " << std::endl;
-			return save_func;
-		}
+				return data;
+			}
+			void assign(csr_array<index_t> value, const std::array<std::uint64_t, N>& current) {
+				std::lock_guard<std::mutex> guard(lock);
+				data = std::move(value);
+				sources = current;
+				valid = true;
+			}
+			void reset() {
+				std::lock_guard<std::mutex> guard(lock);
+				valid = false;
+			}
+		};
+		mutable cached_csr<1> c2f_;
+		mutable cached_csr<2> c2v_;
+		mutable cached_csr<2> v2f_;
+		mutable cached_csr<2> v2c_;
+		mutable cached_csr<2> v2v_;
 	};
 
 
+	std::vector<std::size_t> weld_vertices(pos_t& pos, double tolerance = 1.e-12);
+	f2p_t f2p_from_patches(const std::vector<patch>& patches, std::size_t num_faces);
+	std::vector<std::size_t> group_patch_faces(mesh& msh);
+	mesh merge_meshes(const std::vector<mesh>& pieces);
+	mesh extract_cells(const mesh& msh, std::span<const std::size_t> cells,
+		std::vector<std::size_t>* face_map = nullptr);
+	pos_t cell_point_averages(const mesh& msh);
+	std::vector<std::int32_t> partition_rcb(const pos_t& points, std::size_t num_parts);
 
 
+	// how array data is written; native is each format's usual default
+	enum class data_format { native, ascii, binary, base64 };
 
+	class mesh_io_base {
+	public:
+		virtual ~mesh_io_base() = default;
+		virtual load_t load(std::string fileName) = 0;
+		virtual save_t save(std::string filename) = 0;
 
+		void set_format(data_format format) { format_ = format; }
 
+	protected:
+		data_format format_ = data_format::native;
+	};
 
-
-	class vtu_mesh_io : public mesh_io_base {
+	class stl_mesh_io : public mesh_io_base {
 	public:
 		load_t load(std::string fileName) override {
 
-			load_t load_func;
-
-			std::cout << "Loading OBJ mesh from " << std::endl;
-
-			return load_func;
-		}
-		save_t save(std::string fileName) override {
-			save_t save_func;
 
+			load_t load_func;
 
+			load_func = [fileName](mesh& msh) {
 
-			save_func = [fileName](mesh& msh) {
 
-				std::ofstream outputFile;
-				std::string filenamePlot = fileName;
+				//   
+				std::filesystem::path file_path(fileName);
 
-				outputFile.open(filenamePlot);
-				if (outputFile.fail()) {
-					std::cerr << "Unable to write file for writing." << std::endl;
+				mapped_file file(file_path);
+				if (!file.is_open()) {
+					std::cerr << "Error: Cannot open file " << file_path << '\n';
 					return;
 				}
 
-				using namespace std;
-
-				// string out_line;
-				outputFile << "<?xml version=\"1.0\"?>" << endl;
-				outputFile << " <VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt64\">" << endl;
-				outputFile << "  <UnstructuredGrid>" << endl;
-				outputFile << "   <Piece NumberOfPoints=\"" << msh.pos.size() << "\" NumberOfCells=\"" << msh.c2f.size() << "\">" << endl;
-
-				// Points data
-				outputFile << "    <PointData>" << endl;
-				outputFile << "    </PointData>" << endl;
-				// Cells data
-				outputFile << "    <CellData>" << endl;
-				outputFile << "    </CellData>" << endl;
-				// Points
-				outputFile << "    <Points>" << endl;
-				// }
-				outputFile << "     <DataArray type=\"Float64\" Name=\"NodeCoordinates\" NumberOfComponents=\"3\" format=\"ascii\">" << endl;
-
-				stringstream streamXYZ;
-				outputFile.precision(20);
-				// for(auto iter=mesh.points.begin(); iter!=mesh.points.end(); iter++){
-				for (auto& point : msh.pos) {
-					outputFile << scientific << point[0] << " " << point[1] << " " << point[2] << endl;
-
+				// ascii  б
+				if (is_ascii(file)) {
+					if (!load_ascii(file, msh)) return;
+				}
+				// binary  б
+				else if (!load_binary(file, msh)) {
+					return;
 				}
 
-				outputFile << "    </DataArray>" << endl;
-				outputFile << "   </Points>" << endl;
+				std::cout << "Complete Load STL mesh from " << fileName << std::endl;
 
-				// cells
-				outputFile << "   <Cells>" << endl;
-				// connectivity (cell's points)
-				outputFile << "    <DataArray type=\"Int64\" Name=\"connectivity\" format=\"ascii\">" << endl;
 
-				for (auto& cell : msh.c2v) {
-					for (auto i : cell) {
-						outputFile << i << " ";
-					}
-					outputFile << endl;
-				}
 
-				outputFile << "    </DataArray>" << endl;
+			};
 
-				// offsets (cell's points offset)
-				int cellFaceOffset = 0;
-				outputFile << "    <DataArray type=\"Int64\" Name=\"offsets\" format=\"ascii\">" << endl;
+			return load_func;
 
-				cellFaceOffset = 0;
-				for (auto& cell : msh.c2v) {
-					cellFaceOffset += cell.size();
-					outputFile << cellFaceOffset << " ";
-				}
-				outputFile << endl;
+		}
+		save_t save(std::string filename) override {
 
-				outputFile << "    </DataArray>" << endl;
+			save_t save_func;
 
-				// types (cell's type, 42 = polyhedron)
-				outputFile << "    <DataArray type=\"UInt8\" Name=\"types\" format=\"ascii\">" << endl;
+			// binary unless ascii is asked for
+			save_func = [filename, ascii = format_ == data_format::ascii](mesh& msh) {
 
-				for (auto& cell : msh.c2v) {
-					outputFile << "42" << " ";
+				buffered_writer out(filename);
+				if (!out.is_open()) {
+					std::cerr << "Error: Cannot open file " << filename << '\n';
+					return;
 				}
-				outputFile << endl;
 
-				outputFile << "    </DataArray>" << endl;
+				// volume meshes export their boundary (single-cell) faces only
+				bool boundary_only = msh.f2c.size() == msh.f2v.size() && !msh.f2c.empty();
+				auto skip_face = [&](size_t f) {
+					return msh.f2v[f].size() < 3 || (boundary_only && msh.f2c[f].size() != 1);
+					};
 
-				{
-					// faces (cell's faces number, each face's point number, cell's faces's points)
-					outputFile << "    <DataArray type=\"Int64\" IdType=\"1\" Name=\"faces\" format=\"ascii\">" << endl;
+				size_t num_triangles = 0;
+				for (size_t f = 0; f < msh.f2v.size(); ++f) {
+					if (!skip_face(f)) num_triangles += msh.f2v[f].size() - 2;
+				}
 
-					for (auto& cell : msh.c2f) {
-						outputFile << cell.size() << endl;
-						for (auto& i : cell) {
-							outputFile << msh.f2v[i].size() << " ";
-							int tmp_space = 0;
-							for (auto& j : msh.f2v[i]) {
-								if (tmp_space != msh.f2v[i].size() - 1) {
-									outputFile << j << " ";
-								}
-								else {
-									outputFile << j;
-								}
-								++tmp_space;
-							}
-							outputFile << endl;
+				// faces are fan triangulated from their first vertex
+				auto for_each_triangle = [&](auto&& func) {
+					for (size_t f = 0; f < msh.f2v.size(); ++f) {
+						if (skip_face(f)) continue;
+						auto vs = msh.f2v[f];
+						for (size_t i = 1; i + 1 < vs.size(); ++i) {
+							func(msh.pos.get(vs[0]), msh.pos.get(vs[i]), msh.pos.get(vs[i + 1]));
 						}
 					}
-
-					outputFile << "    </DataArray>" << endl;
-
-
+					};
+
+				if (ascii) {
+					out.write("solid semo\n");
+					for_each_triangle([&](const auto& a, const auto& b, const auto& c) {
+						auto n = triangle_normal(a, b, c);
+						out.write("  facet normal ");
+						write_ascii_xyz(out, n);
+						out.write("    outer loop\n");
+						for (auto p : { &a, &b, &c }) {
+							out.write("      vertex ");
+							write_ascii_xyz(out, *p);
+						}
+						out.write("    endloop\n  endfacet\n");
+						});
+					out.write("endsolid semo\n");
 				}
-
-				int cellFacePointOffset = 0;
-
-				outputFile << "    <DataArray type=\"Int64\" IdType=\"1\" Name=\"faceoffsets\" format=\"ascii\">" << endl;
-
-				cellFacePointOffset = 0;
-				for (auto& face : msh.c2f) {
-					int numbering = 1 + face.size();
-					for (auto& i : face) {
-						numbering += msh.f2v[i].size();
+				else {
+					if (num_triangles > std::numeric_limits<uint32_t>::max()) {
+						std::cerr << "Error: " << num_triangles << " triangles exceed the binary STL limit" << std::endl;
+						return;
 					}
-					cellFacePointOffset += numbering;
-					outputFile << cellFacePointOffset << " ";
-				}
-				outputFile << endl;
-
-				outputFile << "    </DataArray>" << endl;
-				outputFile << "   </Cells>" << endl;
-
-
-				outputFile << "  </Piece>" << endl;
-				outputFile << " </UnstructuredGrid>" << endl;
-
+					char header[80]{};
+					std::strncpy(header, "binary STL written by SEMO_Mesh_IO", sizeof(header) - 1);
+					out.write(header, sizeof(header));
+					out.write_value(static_cast<uint32_t>(num_triangles));
+					for_each_triangle([&](const auto& a, const auto& b, const auto& c) {
+						char record[binary_record_size]{};
+						float values[12];
+						auto n = triangle_normal(a, b, c);
+						const std::array<double, 3>* corners[4] = { &n, &a, &b, &c };
+						for (size_t i = 0; i < 4; ++i) {
+							for (size_t k = 0; k < 3; ++k) {
+								values[3 * i + k] = static_cast<float>((*corners[i])[k]);
+							}
+						}
+						std::memcpy(record, values, sizeof(values));
+						out.write(record, binary_record_size);
+						});
+				}
+
+				out.close();
+				if (!out.good()) {
+					std::cerr << "Error: writing " << filename << " failed" << std::endl;
+					return;
+				}
+				std::cout << "Complete Save STL mesh to " << filename << std::endl;
 
+			};
 
+			std::cout << "Saving STL mesh to " << std::endl;
 
+			return save_func;
+		}
 
-				//// additional informations
-				//{
-				//	string saveFormat = "ascii";
-				//	outputFile << " <DataArray type=\"Int32\" Name=\"owner\" format=\"" << saveFormat << "\">" << endl;
-				//	// vector<int> values;
-				//	for (auto& face : mesh.faces) {
-				//		// values.push_back(face.owner);
-				//		outputFile << face.iL << " ";
-				//	}
-				//	// writeDatasAtVTU(controls, outputFile, values);
-				//	outputFile << endl;
-				//	outputFile << " </DataArray>" << endl;
-				//}
-				//{
-				//	string saveFormat = "ascii";
-				//	outputFile << " <DataArray type=\"Int32\" Name=\"neighbour\" format=\"" << saveFormat << "\">" << endl;
-				//	// vector<int> values;
-				//	for (auto& face : mesh.faces) {
-				//		// values.push_back(face.neighbour);
-				//		if (face.getType() == MASCH_Face_Types::INTERNAL) {
-				//			outputFile << face.iR << " ";
-				//		}
-				//	}
-				//	// writeDatasAtVTU(controls, outputFile, values);
-				//	outputFile << endl;
-				//	outputFile << " </DataArray>" << endl;
-				//}
+	private:
+		// unit normal of triangle (a, b, c), zero for degenerate triangles
+		static std::array<double, 3> triangle_normal(const std::array<double, 3>& a,
+			const std::array<double, 3>& b, const std::array<double, 3>& c) {
+			std::array<double, 3> u{ b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			std::array<double, 3> v{ c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			std::array<double, 3> n{
+				u[1] * v[2] - u[2] * v[1],
+				u[2] * v[0] - u[0] * v[2],
+				u[0] * v[1] - u[1] * v[0] };
+			double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (len > 0.0) {
+				for (auto& x : n) x /= len;
+			}
+			return n;
+		}
 
+		static void write_ascii_xyz(buffered_writer& out, const std::array<double, 3>& xyz) {
+			for (size_t k = 0; k < 3; ++k) {
+				out.write_number(static_cast<float>(xyz[k]), std::chars_format::scientific, 8);
+				out.put(k < 2 ? ' ' : '\n');
+			}
+		}
 
+		// binary STL : 80 byte header, uint32 triangle count, 50 byte records
+		static constexpr std::size_t binary_header_size = 84;
+		static constexpr std::size_t binary_record_size = 50;
 
-				//// boundary informations
-				//{
-				//	outputFile << " <DataArray type=\"Char\" Name=\"bcName\" format=\"" << "ascii" << "\">" << endl;
-				//	// for(auto& boundary : mesh.boundary){
-				//		// // cout << boundary.name << endl;
-				//		// // trim;
-				//		// string bcName = boundary.name;
+		// ascii files start with "solid", but so do some binary exporters' headers,
+		// so a file whose size matches its binary triangle count is treated as binary
+		static bool is_ascii(const mapped_file& file) {
+			if (file.size() < 5 || std::memcmp(file.data(), "solid", 5) != 0) {
+				return false;
+			}
+			if (file.size() >= binary_header_size) {
+				uint32_t num_triangles = 0;
+				std::memcpy(&num_triangles, file.data() + 80, sizeof(uint32_t));
+				if (file.size() == binary_header_size + binary_record_size * num_triangles) {
+					return false;
+				}
+			}
+			return true;
+		}
 
-				//		// bcName.erase(std::find_if(bcName.rbegin(), bcName.rend(), std::not1(std::ptr_fun<int, int>(std::isspace))).base(), bcName.end());
-				//		// bcName.erase(bcName.begin(), std::find_if(bcName.begin(), bcName.end(), std::not1(std::ptr_fun<int, int>(std::isspace))));
+		// vertices and per-facet vertex counts of one block of an ascii file
+		struct ascii_block {
+			pos_t pos;
+			std::vector<size_t> face_sizes;
+		};
+
+		// parses facets in [begin, end); solid / endsolid lines are skipped,
+		// so files holding several solids are read completely. On a bad vertex
+		// the open facet is dropped and false is returned.
+		static bool parse_ascii_block(const char* begin, const char* end, ascii_block& block) {
+			text_scanner scan(begin, end);
+			bool in_facet = false;
+			size_t face_size = 0;
+			while (!scan.eof()) {
+				auto token = scan.next_token();
+				if (token == "vertex") {
+					std::array<double, 3> xyz{};
+					if (!(scan.parse(xyz[0]) && scan.parse(xyz[1]) && scan.parse(xyz[2]))) {
+						std::cerr << "Error: bad vertex in ascii STL" << std::endl;
+						if (in_facet) block.pos.resize(block.pos.size() - face_size);
+						return false;
+					}
+					if (in_facet) {
+						block.pos.push_back(xyz);
+						++face_size;
+					}
+				}
+				else if (token == "facet") {
+					in_facet = true;
+					face_size = 0;
+				}
+				else if (token == "endfacet") {
+					if (in_facet && face_size > 0) {
+						block.face_sizes.push_back(face_size);
+					}
+					else {
+						block.pos.resize(block.pos.size() - face_size);
+					}
+					in_facet = false;
+				}
+				else if (token == "solid" || token == "endsolid") {
+					// the rest of the line is the solid name
+					scan.skip_line();
+				}
+			}
+			// unterminated last facet
+			if (in_facet) {
+				block.pos.resize(block.pos.size() - face_size);
+			}
+			return true;
+		}
 
+		// splits the file at facet boundaries, parses the blocks on separate
+		// threads and appends them to msh in file order; msh is left as it
+		// was when a block fails
+		static bool load_ascii(const mapped_file& file, mesh& msh) {
+			const char* begin = file.data();
+			const char* end = begin + file.size();
+
+			constexpr size_t min_block_bytes = 1 << 20;
+			size_t num_blocks = std::max<size_t>(1, std::min(num_threads(), file.size() / min_block_bytes));
+			std::vector<const char*> cuts(num_blocks + 1, end);
+			cuts[0] = begin;
+			for (size_t b = 1; b < num_blocks; ++b) {
+				const char* guess = std::max(cuts[b - 1], begin + file.size() / num_blocks * b);
+				cuts[b] = find_token(guess, end, "facet");
+			}
 
-				//		// // outputFile << boundary.name << " ";
-				//		// outputFile << bcName << " ";
-				//	// }
-				//	for (auto& boundary : mesh.boundaries) {
-				//		// cout << boundary.name << endl;
-				//		outputFile << boundary.name << " ";
-				//	}
-				//	outputFile << endl;
-				//	outputFile << " </DataArray>" << endl;
+			std::vector<ascii_block> blocks(num_blocks);
+			std::vector<char> ok(num_blocks, 0);
+			parallel_for(0, num_blocks, [&](size_t b0, size_t b1) {
+				for (size_t b = b0; b < b1; ++b) {
+					ok[b] = parse_ascii_block(cuts[b], cuts[b + 1], blocks[b]);
+				}
+				}, 1);
+			if (std::find(ok.begin(), ok.end(), 0) != ok.end()) return false;
+
+			// stitch blocks : the facets of a block use its vertices in order
+			size_t pos0 = msh.pos.size();
+			size_t ent0 = msh.f2v.num_entries();
+			std::vector<size_t> pos_offsets(num_blocks + 1, 0);
+			std::vector<size_t> ent_offsets(num_blocks + 1, 0);
+			for (size_t b = 0; b < num_blocks; ++b) {
+				size_t num_entries = std::accumulate(blocks[b].face_sizes.begin(), blocks[b].face_sizes.end(), size_t{ 0 });
+				if (num_entries != blocks[b].pos.size()) {
+					std::cerr << "Error: facets and vertices do not match in ascii STL" << std::endl;
+					return false;
+				}
+				pos_offsets[b + 1] = pos_offsets[b] + blocks[b].pos.size();
+				ent_offsets[b + 1] = ent_offsets[b] + num_entries;
+			}
+			size_t num_pos = pos_offsets[num_blocks];
+			if (!fits_index(pos0 + num_pos, "points")) return false;
+			for (size_t b = 0; b < num_blocks; ++b) {
+				msh.f2v.append_counts(blocks[b].face_sizes);
+			}
+			msh.pos.resize(pos0 + num_pos);
+
+			auto& f2v = msh.f2v.indices();
+			parallel_for(0, num_blocks, [&](size_t b0, size_t b1) {
+				for (size_t b = b0; b < b1; ++b) {
+					msh.pos.copy_from(blocks[b].pos, pos0 + pos_offsets[b]);
+					for (size_t j = 0; j < ent_offsets[b + 1] - ent_offsets[b]; ++j) {
+						f2v[ent0 + ent_offsets[b] + j] = static_cast<index_t>(pos0 + pos_offsets[b] + j);
+					}
+				}
+				}, 1);
+			return true;
+		}
 
-				//	outputFile << " <DataArray type=\"Int32\" Name=\"bcStartFace\" format=\"" << "ascii" << "\">" << endl;
-				//	for (auto& boundary : mesh.boundaries) {
-				//		outputFile << boundary.startFace << " ";
-				//	}
-				//	outputFile << endl;
-				//	outputFile << " </DataArray>" << endl;
+		// decodes all records straight from the mapped file into presized pos / f2v
+		static bool load_binary(const mapped_file& file, mesh& msh) {
+			if (file.size() < binary_header_size) {
+				std::cerr << "Error: binary STL header is truncated" << std::endl;
+				return false;
+			}
+			uint32_t num_triangles = 0;
+			std::memcpy(&num_triangles, file.data() + 80, sizeof(uint32_t));
+			if (file.size() < binary_header_size + binary_record_size * num_triangles) {
+				std::cerr << "Error: binary STL has fewer records than its header count " << num_triangles << std::endl;
+				return false;
+			}
 
-				//	outputFile << " <DataArray type=\"Int32\" Name=\"bcNFaces\" format=\"" << "ascii" << "\">" << endl;
-				//	for (auto& boundary : mesh.boundaries) {
-				//		outputFile << boundary.nFaces << " ";
-				//	}
-				//	outputFile << endl;
-				//	outputFile << " </DataArray>" << endl;
+			size_t pos0 = msh.pos.size();
+			size_t ent0 = msh.f2v.num_entries();
+			if (!fits_index(pos0 + 3 * static_cast<size_t>(num_triangles), "points")) return false;
+			msh.pos.resize(pos0 + 3 * static_cast<size_t>(num_triangles));
+			msh.f2v.append_uniform(num_triangles, 3);
+
+			const char* records = file.data() + binary_header_size;
+			auto& pos = msh.pos;
+			auto& f2v = msh.f2v.indices();
+			parallel_for(0, num_triangles, [&](size_t begin, size_t end) {
+				for (size_t idx = begin; idx < end; ++idx) {
+					// normal (3 floats) is skipped, then 3 vertices
+					float vertex_t[9];
+					std::memcpy(vertex_t, records + binary_record_size * idx + 3 * sizeof(float), sizeof(vertex_t));
+					for (size_t i = 0; i < 3; ++i) {
+						size_t v = pos0 + 3 * idx + i;
+						pos.set(v, vertex_t[3 * i + 0], vertex_t[3 * i + 1], vertex_t[3 * i + 2]);
+						f2v[ent0 + 3 * idx + i] = v;
+					}
+				}
+				});
 
-				//	outputFile << " <DataArray type=\"Int32\" Name=\"bcNeighbProcNo\" format=\"" << "ascii" << "\">" << endl;
-				//	for (auto& boundary : mesh.boundaries) {
-				//		// cout << boundary.rightProcNo << endl;
-				//		outputFile << boundary.rightProcNo << " ";
-				//	}
-				//	outputFile << endl;
-				//	outputFile << " </DataArray>" << endl;
+			return true;
+		}
+	};
 
-				//	outputFile << " <DataArray type=\"Int32\" Name=\"connPoints\" format=\"" << "ascii" << "\">" << endl;
-				//	for (int i = 0; i < mesh.points.size(); ++i) {
-				//		auto& point = mesh.points[i];
-				//		for (auto& [item, item2] : point.connPoints) {
-				//			outputFile << i << " " << item << " " << item2 << " ";
-				//		}
-				//		// if(!point.connPoints.empty()) outputFile << endl;
-				//	}
-				//	outputFile << endl;
-				//	outputFile << " </DataArray>" << endl;
+	class obj_mesh_io : public mesh_io_base {
+	public:
+		load_t load(std::string fileName) override {
 
+			load_t load_func;
 
-				//}
+			load_func = [fileName](mesh& msh) {
 
-				outputFile << "</VTKFile>" << endl;
+				mapped_file file(fileName);
+				if (!file.is_open()) {
+					std::cerr << "Error: Cannot open file " << fileName << '\n';
+					return;
+				}
+				const char* begin = file.data();
+				const char* end = begin + file.size();
+
+				constexpr size_t min_block_bytes = 1 << 20;
+				size_t num_blocks = std::max<size_t>(1, std::min(num_threads(), file.size() / min_block_bytes));
+				auto cuts = split_at_lines(begin, end, num_blocks);
+
+				// pass 1 : count vertices, faces and face entries per block
+				std::vector<block_counts> counts(num_blocks + 1);
+				parallel_for(0, num_blocks, [&](size_t b0, size_t b1) {
+					for (size_t b = b0; b < b1; ++b) {
+						counts[b + 1] = count_block(cuts[b], cuts[b + 1]);
+					}
+					}, 1);
+				// exclusive prefix sums : first vertex / face / entry of each block
+				for (size_t b = 1; b <= num_blocks; ++b) {
+					counts[b].vertices += counts[b - 1].vertices;
+					counts[b].faces += counts[b - 1].faces;
+					counts[b].entries += counts[b - 1].entries;
+				}
 
-				outputFile.close();
+				size_t pos0 = msh.pos.size();
+				size_t face0 = msh.f2v.size();
+				size_t ent0 = msh.f2v.num_entries();
+				if (!fits_index(pos0 + counts[num_blocks].vertices, "points")) return;
+				msh.pos.resize(pos0 + counts[num_blocks].vertices);
+				msh.f2v.offsets().resize(face0 + counts[num_blocks].faces + 1);
+				msh.f2v.indices().resize(ent0 + counts[num_blocks].entries);
+
+				// pass 2 : parse straight into the presized arrays
+				std::atomic<size_t> num_bad{ 0 };
+				parallel_for(0, num_blocks, [&](size_t b0, size_t b1) {
+					for (size_t b = b0; b < b1; ++b) {
+						block_counts start = counts[b];
+						start.vertices += pos0;
+						start.faces += face0;
+						start.entries += ent0;
+						num_bad += parse_block(cuts[b], cuts[b + 1], start, pos0, msh);
+					}
+					}, 1);
 
-				// }
+				if (num_bad > 0) {
+					std::cerr << "Error: " << num_bad << " bad records in " << fileName << std::endl;
+					msh.pos.resize(pos0);
+					msh.f2v.offsets().resize(face0 + 1);
+					msh.f2v.indices().resize(ent0);
+					return;
+				}
 
+				std::cout << "Complete Load OBJ mesh from " << fileName << std::endl;
 
+			};
 
+			return load_func;
 
 
 
+		}
+		save_t save(std::string fileName) override {
+			save_t save_func;
 
+			save_func = [fileName](mesh& msh) {
+				std::ofstream file(fileName);
+				if (!file.is_open()) {
+					std::cerr << "   ϴ." << std::endl;
+					return;
+				}
 
+				for (const auto& v : msh.pos) {
+					file << "v " << v[0] << " " << v[1] << " " << v[2] << std::endl;
+				}
+				for (auto v : msh.f2v) {
+					file << "f";
+					for (auto i : v) {
+						file << " " << i + 1;
+					}
+					file << std::endl;
+				}
 
+				file.close();
 				std::cout << "  Ǿϴ." << std::endl;
 
-				};
+			};
 
 
 
 			std::cout << "Saving OBJ mesh to " << std::endl;
 			return save_func;
 		}
-	};
-
 
+	private:
+		struct block_counts {
+			size_t vertices = 0;
+			size_t faces = 0;
+			size_t entries = 0;
+		};
+
+		static bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+		// line keyword ("v", "f", ...) and the position after it
+		static std::string_view keyword(const char*& p, const char* line_end) {
+			while (p != line_end && is_blank(*p)) ++p;
+			const char* k = p;
+			while (p != line_end && !is_blank(*p)) ++p;
+			return std::string_view(k, p - k);
+		}
 
-
-
-
-
-	class mesh_io_factory {
-	public:
-		mesh_io_factory() {
-			creators["stl"] = []() { return std::make_unique<stl_mesh_io>(); };
-			creators["obj"] = []() { return std::make_unique<obj_mesh_io>(); };
-			creators["vtu"] = []() { return std::make_unique<vtu_mesh_io>(); };
-			creators[""] = []() { return std::make_unique<openfoam_mesh_io>(); };
+		static block_counts count_block(const char* begin, const char* end) {
+			block_counts c;
+			for (const char* line = begin; line < end; ) {
+				const char* line_end = std::find(line, end, '\n');
+				const char* p = line;
+				auto key = keyword(p, line_end);
+				if (key == "v") {
+					++c.vertices;
+				}
+				else if (key == "f") {
+					++c.faces;
+					// one entry per blank separated v, v/vt, v//vn or v/vt/vn group
+					while (p != line_end) {
+						while (p != line_end && is_blank(*p)) ++p;
+						if (p == line_end) break;
+						++c.entries;
+						while (p != line_end && !is_blank(*p)) ++p;
+					}
+				}
+				line = line_end == end ? end : line_end + 1;
+			}
+			return c;
 		}
 
-		std::unique_ptr<mesh_io_base> create(const std::string& format) {
-			auto it = creators.find(format);
-			if (it != creators.end()) {
-				return it->second();
-			}
-			else {
-				return nullptr;
+		// parses one block; start holds the global index of its first vertex / face / entry.
+		// Returns the number of malformed records.
+		static size_t parse_block(const char* begin, const char* end, block_counts start,
+			size_t pos0, mesh& msh) {
+			size_t num_bad = 0;
+			size_t v = start.vertices;
+			size_t f = start.faces;
+			size_t e = start.entries;
+			auto& offsets = msh.f2v.offsets();
+			auto& indices = msh.f2v.indices();
+			for (const char* line = begin; line < end; ) {
+				const char* line_end = std::find(line, end, '\n');
+				const char* p = line;
+				auto key = keyword(p, line_end);
+				if (key == "v") {
+					text_scanner scan(p, line_end);
+					std::array<double, 3> xyz{};
+					if (!(scan.parse(xyz[0]) && scan.parse(xyz[1]) && scan.parse(xyz[2]))) {
+						++num_bad;
+					}
+					msh.pos[v++] = xyz;
+				}
+				else if (key == "f") {
+					while (p != line_end) {
+						while (p != line_end && is_blank(*p)) ++p;
+						if (p == line_end) break;
+						// vertex index is the part before the first '/'
+						long long idx = 0;
+						auto [ptr, ec] = std::from_chars(p, line_end, idx);
+						if (ec != std::errc() || idx == 0) {
+							++num_bad;
+							indices[e++] = 0;
+						}
+						else {
+							// relative indices count back from the vertices read so far
+							long long vi = idx > 0 ? idx - 1 : static_cast<long long>(v - pos0) + idx;
+							if (vi < 0 || static_cast<size_t>(vi) >= msh.pos.size() - pos0) {
+								++num_bad;
+								vi = 0;
+							}
+							indices[e++] = pos0 + static_cast<size_t>(vi);
+						}
+						while (p != line_end && !is_blank(*p)) ++p;
+					}
+					offsets[++f] = e;
+				}
+				line = line_end == end ? end : line_end + 1;
 			}
+			return num_bad;
 		}
-
-	private:
-		std::map<std::string, std::function<std::unique_ptr<mesh_io_base>()>> creators;
 	};
 
 
 
 
 
-	class mesh_io {
+
+	class openfoam_mesh_io : public mesh_io_base {
 	public:
-		std::optional<load_t> load(const std::string& filename) {
-			std::string format = get_file_extension(filename);
-			to_lower(format);
-			mesh_io_ = std::make_unique<mesh_io_factory>()->create(format);
-			if (!mesh_io_) {
-				std::cerr << "Unknown format: " << format << std::endl;
-				return std::nullopt;
-			}
-			return mesh_io_->load(filename);
-		}
+		// fileName is the polyMesh directory; each file may be ascii or binary
+		// (FoamFile format entry), binary labels may be 32 or 64 bit
+		load_t load(std::string fileName) override {
 
-		std::optional<save_t> save(const std::string& filename) {
-			std::string format = get_file_extension(filename);
-			to_lower(format);
-			mesh_io_ = std::make_unique<mesh_io_factory>()->create(format);
-			if (!mesh_io_) {
-				std::cerr << "Unknown format: " << format << std::endl;
-				return std::nullopt;
-			}
-			return mesh_io_->save(filename);
-		}
+			load_t load_func;
 
-	private:
-		std::unique_ptr<mesh_io_base> mesh_io_;
-	};
+			load_func = [fileName](mesh& msh) {
+
+				auto& pos = msh.pos;
+				auto& f2v = msh.f2v;
+				auto& f2c = msh.f2c;
 
 
+				std::string gridFolderName = fileName;
+				std::string pointsName = "points";
+				std::string facesName = "faces";
+				std::string ownerName = "owner";
+				std::string neighbourName = "neighbour";
+				std::string boundaryName = "boundary";
 
+				// the four big files are independent : parse them concurrently
+				pos.clear();
+				f2v.clear();
+				std::vector<index_t> owner;
+				std::vector<index_t> neighbour;
+				bool ok[4] = {};
+				std::thread threads[] = {
+					std::thread([&]() { ok[0] = read_points(gridFolderName + "/" + pointsName, pos); }),
+					std::thread([&]() { ok[1] = read_faces(gridFolderName + "/" + facesName, f2v); }),
+					std::thread([&]() { ok[2] = read_labels(gridFolderName + "/" + ownerName, owner); }) };
+				ok[3] = read_labels(gridFolderName + "/" + neighbourName, neighbour);
+				for (auto& t : threads) t.join();
+				if (!(ok[0] && ok[1] && ok[2] && ok[3])) return;
+				if (owner.size() != f2v.size() || neighbour.size() > owner.size()) {
+					std::cerr << "Error: owner/neighbour sizes do not match faces in " << gridFolderName << std::endl;
+					return;
+				}
+				// a cell has at least four faces, so the cells fit when the faces do
+				if (!fits_index(pos.size(), "points") || !fits_index(f2v.size(), "faces")) return;
+
+				// labels out of range (negative ones in the file included) would
+				// break every later traversal; the cell count is the largest cell
+				// label plus one and never exceeds the face count
+				if (!labels_below(std::as_const(f2v).indices(), pos.size())) {
+					std::cerr << "Error: face point label out of range in " << gridFolderName << std::endl;
+					return;
+				}
+				if (!labels_below(owner, owner.size()) || !labels_below(neighbour, owner.size())) {
+					std::cerr << "Error: owner/neighbour cell label out of range in " << gridFolderName << std::endl;
+					return;
+				}
 
+				// face to cell connectivity (owner, neighbour) : internal faces first
+				size_t num_faces = owner.size();
+				size_t num_internal = neighbour.size();
+				auto& f2c_offsets = f2c.offsets();
+				auto& f2c_cells = f2c.indices();
+				f2c_offsets.resize(num_faces + 1);
+				f2c_cells.resize(num_faces + num_internal);
+				parallel_for(0, num_faces + 1, [&](size_t i0, size_t i1) {
+					for (size_t i = i0; i < i1; ++i) f2c_offsets[i] = i + std::min(i, num_internal);
+					});
+				parallel_for(0, num_faces, [&](size_t i0, size_t i1) {
+					for (size_t i = i0; i < i1; ++i) {
+						size_t at = f2c_offsets[i];
+						f2c_cells[at] = owner[i];
+						if (i < num_internal) f2c_cells[at + 1] = neighbour[i];
+					}
+					});
 
-	void make_c2f_from_f2c(mesh& msh) {
 
-		if (msh.f2c.size() == 0) {
-			std::cerr << "f2c is empty" << std::endl;
-			return;
-		}
 
-		size_t num_cell = 0;
-		for (auto& cs : msh.f2c) {
-			for (auto& c : cs) {
-				if(c > num_cell) num_cell = c;
-			}
-		}
-		num_cell += 1;
-		msh.c2f.resize(num_cell);
-		for (size_t f = 0; auto & cs : msh.f2c) {
-			for (auto& c : cs) {
-				msh.c2f[c].push_back(f);
-			}
-			++f;
-		}
+				// boundary patches
+				if (!read_boundary(gridFolderName + "/" + boundaryName, num_faces, msh.patches)) return;
+				make_f2p_from_patches(msh);
 
-	}
+				std::cout << "Complete Load OpenFOAM mesh from " << fileName << std::endl;
 
 
-	void make_c2v_from_c2f_f2v(mesh& msh) {
+			};
+
+			return load_func;
+
 
-		if (msh.c2f.size() == 0) {
-			std::cerr << "c2f is empty" << std::endl;
-			return;
-		}
-		if (msh.f2v.size() == 0) {
-			std::cerr << "f2v is empty" << std::endl;
-			return;
 		}
+		save_t save(std::string fileName) override {
+			save_t save_func;
 
-		msh.c2v.resize(msh.c2f.size());
-		for (size_t i = 0; auto & fs : msh.c2f) {
-			auto& c2v_r = msh.c2v[i];
-			for (auto& f : fs) {
-				for (auto& v : msh.f2v[f]) {
-					c2v_r.push_back(v);
+			// fileName is the polyMesh directory; ascii unless binary is asked for
+			save_func = [fileName, binary = format_ == data_format::binary, compact = compact_faces_](mesh& msh) {
+
+				if (msh.f2c.size() != msh.f2v.size()) {
+					std::cerr << "Error: OpenFOAM output needs face to cell connectivity (f2c)" << std::endl;
+					return;
+				}
+				std::error_code ec;
+				std::filesystem::create_directories(fileName, ec);
+				if (ec) {
+					std::cerr << "Unable to create directory : " << fileName << std::endl;
+					return;
 				}
-			}
-			std::sort(c2v_r.begin(), c2v_r.end());
-			std::unique(c2v_r.begin(), c2v_r.end());
-			++i;
-		}
 
-	}
+				face_order order;
+				if (!order_faces(msh, order)) return;
+
+				foam_output out;
+				out.binary = binary;
+				out.label_size = 4;
+				size_t largest = std::max({ msh.pos.size(), msh.f2v.size(), msh.f2v.num_entries(), order.num_cells });
+				if (largest > static_cast<size_t>(std::numeric_limits<int32_t>::max())) out.label_size = 8;
+				out.note = "nPoints:" + std::to_string(msh.pos.size()) + " nCells:" + std::to_string(order.num_cells) +
+					" nFaces:" + std::to_string(msh.f2v.size()) + " nInternalFaces:" + std::to_string(order.num_internal);
+
+				// one thread per file
+				std::string dir = fileName + "/";
+				bool use_compact = compact.value_or(binary);
+				bool ok[5] = {};
+				std::thread threads[] = {
+					std::thread([&]() { ok[0] = write_points(dir + "points", out, msh.pos); }),
+					std::thread([&]() { ok[1] = write_faces(dir + "faces", out, msh, order, use_compact); }),
+					std::thread([&]() { ok[2] = write_cells(dir + "owner", out, msh, order, 0); }),
+					std::thread([&]() { ok[3] = write_cells(dir + "neighbour", out, msh, order, 1); }) };
+				ok[4] = write_boundary(dir + "boundary", order);
+				for (auto& t : threads) t.join();
+				if (!(ok[0] && ok[1] && ok[2] && ok[3] && ok[4])) {
+					std::cerr << "Error: failed to write OpenFOAM mesh to " << fileName << std::endl;
+					return;
+				}
 
+				std::cout << "Complete Save OpenFOAM mesh to " << fileName << std::endl;
+			};
 
+			return save_func;
+		}
 
-	class mesh_treatment {
-	public:
+		// faces file as faceCompactList (true) or faceList (false); by default
+		// compact for binary and a plain list for ascii, like OpenFOAM
+		void set_compact_faces(bool compact) { compact_faces_ = compact; }
 
+	private:
+		//----------------------------------------------
+		// FoamFile header and list access on a mapped polyMesh file
+
+		struct foam_file {
+			mapped_file file;
+			bool binary = false;
+			bool swap = false;          // arch differs from this machine's byte order
+			size_t label_size = 4;      // label=32 or label=64
+			size_t scalar_size = 8;     // scalar=32 or scalar=64
+			std::string class_name;
+			const char* p = nullptr;    // read cursor, after the header
+			const char* end = nullptr;
+		};
+
+		// whitespace, // and /* */ comments
+		static const char* skip_foam_space(const char* p, const char* end) {
+			while (p != end) {
+				if (text_scanner::is_space(*p)) {
+					++p;
+				}
+				else if (*p == '/' && p + 1 != end && p[1] == '/') {
+					p = std::find(p, end, '\n');
+				}
+				else if (*p == '/' && p + 1 != end && p[1] == '*') {
+					std::string_view rest(p + 2, end - p - 2);
+					size_t at = rest.find("*/");
+					p = at == std::string_view::npos ? end : p + 2 + at + 2;
+				}
+				else {
+					break;
+				}
+			}
+			return p;
+		}
 
+		// value of "key value;" inside a dictionary body, quotes removed
+		static std::string_view dict_entry(std::string_view dict, std::string_view key) {
+			const char* at = find_token(dict.data(), dict.data() + dict.size(), key);
+			if (at == dict.data() + dict.size()) return {};
+			std::string_view rest(at + key.size(), dict.data() + dict.size() - at - key.size());
+			while (!rest.empty() && text_scanner::is_space(rest.front())) rest.remove_prefix(1);
+			// quoted values may hold ';' (arch "LSB;label=32;scalar=64")
+			size_t close = rest.starts_with('"') ? rest.find('"', 1) : rest.find(';');
+			if (close == std::string_view::npos) return {};
+			if (rest.starts_with('"')) return rest.substr(1, close - 1);
+			rest = rest.substr(0, close);
+			while (!rest.empty() && text_scanner::is_space(rest.back())) rest.remove_suffix(1);
+			return rest;
+		}
 
+		static bool open_foam_file(const std::string& path, foam_file& foam) {
+			if (!foam.file.open(path)) {
+				std::cerr << "Unable to open file for reading : " << path << std::endl;
+				return false;
+			}
+			const char* begin = foam.file.data();
+			foam.end = begin + foam.file.size();
+			foam.p = begin;
+
+			const char* p = skip_foam_space(begin, foam.end);
+			std::string_view rest(p, foam.end - p);
+			if (!rest.starts_with("FoamFile")) return true;   // headerless ascii
+			const char* open = std::find(p, foam.end, '{');
+			const char* close = std::find(open, foam.end, '}');
+			if (close == foam.end) {
+				std::cerr << "Error: broken FoamFile header in " << path << std::endl;
+				return false;
+			}
+			std::string_view header(open + 1, close - open - 1);
+			foam.p = close + 1;
+
+			foam.binary = dict_entry(header, "format") == "binary";
+			foam.class_name = std::string(dict_entry(header, "class"));
+			std::string_view arch = dict_entry(header, "arch");
+			if (arch.find("label=64") != std::string_view::npos) foam.label_size = 8;
+			if (arch.find("scalar=32") != std::string_view::npos) foam.scalar_size = 4;
+			bool file_msb = arch.find("MSB") != std::string_view::npos;
+			foam.swap = file_msb != (std::endian::native == std::endian::big);
+			return true;
+		}
 
+		// reads "N (" and leaves the cursor on the first list byte
+		static bool list_begin(foam_file& foam, size_t& n) {
+			const char* p = skip_foam_space(foam.p, foam.end);
+			auto [ptr, ec] = std::from_chars(p, foam.end, n);
+			if (ec != std::errc()) return false;
+			p = skip_foam_space(ptr, foam.end);
+			if (p == foam.end || *p != '(') return false;
+			foam.p = p + 1;
+			return true;
+		}
 
-	};
+		// n binary values of value_size bytes followed by ')'
+		static const unsigned char* binary_block(foam_file& foam, size_t n, size_t value_size) {
+			if (static_cast<size_t>(foam.end - foam.p) < n * value_size + 1) return nullptr;
+			auto data = reinterpret_cast<const unsigned char*>(foam.p);
+			foam.p += n * value_size;
+			if (*foam.p != ')') return nullptr;
+			++foam.p;
+			return data;
+		}
 
+		// false on a short block or a label that is negative or past the range
+		// of Out, checked before it is narrowed (label=64 into 32 bit indices)
+		template<typename Out>
+		static bool read_binary_labels(foam_file& foam, size_t n, Out* out) {
+			auto data = binary_block(foam, n, foam.label_size);
+			if (data == nullptr) return false;
+			if (foam.label_size == 8) return convert_labels<int64_t>(data, n, foam.swap, out);
+			return convert_labels<int32_t>(data, n, foam.swap, out);
+		}
 
+		template<typename Src, typename Out>
+		static bool convert_labels(const unsigned char* data, size_t n, bool swap, Out* out) {
+			constexpr std::uint64_t largest = std::min<std::uint64_t>(std::numeric_limits<Src>::max(), std::numeric_limits<Out>::max());
+			std::atomic<bool> ok{ true };
+			if constexpr (sizeof(Src) <= sizeof(Out)) {
+				// nothing is cut off : a negative label turns into a value past largest
+				convert_values<Src>(data, n, swap, out);
+				parallel_for(0, n, [&](size_t i0, size_t i1) {
+					if (std::any_of(out + i0, out + i1, [](Out v) { return static_cast<std::uint64_t>(v) > largest; })) ok = false;
+					});
+			}
+			else {
+				parallel_for(0, n, [&](size_t i0, size_t i1) {
+					bool fine = true;
+					for (size_t i = i0; i < i1; ++i) {
+						Src v = decode_value<Src>(data + i * sizeof(Src), swap);
+						fine &= v >= 0 && static_cast<std::uint64_t>(v) <= largest;
+						out[i] = static_cast<Out>(v);
+					}
+					if (!fine) ok = false;
+					});
+			}
+			return ok;
+		}
 
+		static bool read_points(const std::string& path, pos_t& pos) {
+			foam_file foam;
+			if (!open_foam_file(path, foam)) return false;
+			if (!foam.binary) return read_ascii_points(foam, path, pos);
 
+			size_t n = 0;
+			const unsigned char* data = nullptr;
+			if (list_begin(foam, n)) data = binary_block(foam, 3 * n, foam.scalar_size);
+			if (data == nullptr) {
+				std::cerr << "Error: bad binary vectorField in " << path << std::endl;
+				return false;
+			}
+			if (foam.scalar_size == 4) convert_points<float>(data, n, foam.swap, pos);
+			else convert_points<double>(data, n, foam.swap, pos);
+			return true;
+		}
 
-	//===================================================
-	// ҵ    Ȯϴ Լ
-	template <typename Container>
-	bool approximately_equal(const Container& a, const Container& b,
-		const typename Container::value_type& epsilon =
-		2.0 * std::numeric_limits<typename Container::value_type>::epsilon()) {
-		auto it_a = a.begin();
-		auto it_b = b.begin();
+		// faceCompactList (offsets list then vertex list) or faceList
+		static bool read_faces(const std::string& path, f2v_t& f2v) {
+			foam_file foam;
+			if (!open_foam_file(path, foam)) return false;
+			if (!foam.binary) return read_ascii_faces(foam, path, f2v);
 
-		while (it_a != a.end() && it_b != b.end()) {
-			if (std::abs(*it_a - *it_b) > epsilon) {
+			auto fail = [&path]() {
+				std::cerr << "Error: bad binary face list in " << path << std::endl;
 				return false;
+				};
+
+			if (foam.class_name == "faceCompactList") {
+				size_t num_offsets = 0;
+				if (!list_begin(foam, num_offsets)) return fail();
+				auto& offsets = f2v.offsets();
+				offsets.resize(num_offsets);
+				if (!read_binary_labels(foam, num_offsets, offsets.data())) return fail();
+				if (num_offsets == 0) offsets.assign(1, 0);
+
+				size_t num_indices = 0;
+				if (!list_begin(foam, num_indices)) return fail();
+				if (offsets.front() != 0 || offsets.back() != num_indices ||
+					!std::is_sorted(offsets.begin(), offsets.end())) return fail();
+				auto& indices = f2v.indices();
+				indices.resize(num_indices);
+				if (!read_binary_labels(foam, num_indices, indices.data())) return fail();
+				return true;
 			}
-			++it_a;
-			++it_b;
+
+			// faceList : every face is its own "n (raw labels)" entry
+			size_t num_faces = 0;
+			if (!list_begin(foam, num_faces)) return fail();
+			f2v.reserve(num_faces, 4 * num_faces);
+			for (size_t i = 0; i < num_faces; ++i) {
+				size_t n = 0;
+				if (!list_begin(foam, n)) return fail();
+				auto data = binary_block(foam, n, foam.label_size);
+				if (data == nullptr) return fail();
+				// faces are short : decode in place instead of going through parallel_for
+				f2v.emplace_back();
+				for (size_t k = 0; k < n; ++k) {
+					unsigned char bytes[8];
+					std::memcpy(bytes, data + k * foam.label_size, foam.label_size);
+					if (foam.swap) std::reverse(bytes, bytes + foam.label_size);
+					int64_t v;
+					if (foam.label_size == 8) {
+						std::memcpy(&v, bytes, 8);
+					}
+					else {
+						int32_t v32;
+						std::memcpy(&v32, bytes, 4);
+						v = v32;
+					}
+					if (v < 0 || static_cast<std::uint64_t>(v) > std::numeric_limits<index_t>::max()) return fail();
+					f2v.append_to_back(static_cast<index_t>(v));
+				}
+			}
+			return true;
 		}
 
-		return true;
-	}
+		static index_t max_label(const std::vector<index_t>& labels) {
+			std::atomic<index_t> largest{ 0 };
+			parallel_for(0, labels.size(), [&](size_t i0, size_t i1) {
+				index_t m = *std::max_element(labels.begin() + i0, labels.begin() + i1);
+				index_t cur = largest.load();
+				while (cur < m && !largest.compare_exchange_weak(cur, m)) {}
+				});
+			return largest.load();
+		}
 
+		// every label smaller than limit
+		static bool labels_below(const std::vector<index_t>& labels, size_t limit) {
+			return labels.empty() || static_cast<size_t>(max_label(labels)) < limit;
+		}
 
-	//===================================================
-	// ־ ̳  "" "ߺ " ,
-	// ŵ     ܼ ä , 
-	//   ο ε(ߺ̸ ߺ   
-	//  ù°  ε)  ȯմϴ.
-	template <typename Container, typename Func =
-		std::function<typename Container::value_type& (typename Container::value_type&)>>
-		std::vector<std::size_t> sort_and_unique_indices(
-			Container& values,
-			Func func = [](auto& p) ->
-			auto& {
-				return p;
-			}) {
-		//template <typename Container, typename Func>
-		//std::vector<unsigned> sortAndUniqueIndices(Container & values, Func func) {
-			//std::function<T> func = [](typename Container::value_type& p) { return p; }) {
+		// owner / neighbour labelList
+		static bool read_labels(const std::string& path, std::vector<index_t>& labels) {
+			foam_file foam;
+			if (!open_foam_file(path, foam)) return false;
+			if (!foam.binary) return read_ascii_labels(foam, path, labels);
 
-		std::vector<std::size_t> indices(values.size());
-		std::vector<std::size_t*> indicesPtr(values.size());
-		for (std::size_t i = 0; i < values.size(); ++i) {
-			indices[i] = i;
-			indicesPtr[i] = &indices[i];
+			size_t n = 0;
+			if (!list_begin(foam, n)) {
+				std::cerr << "Error: bad binary labelList in " << path << std::endl;
+				return false;
+			}
+			labels.resize(n);
+			if (!read_binary_labels(foam, n, labels.data())) {
+				std::cerr << "Error: bad binary labelList in " << path << std::endl;
+				return false;
+			}
+			return true;
 		}
-		//std::iota(std::begin(indices), std::end(indices), 0);
 
-		// ־ Լ ̿Ͽ  Ͽ ε մϴ.
-		std::sort(indicesPtr.begin(), indicesPtr.end(),
-			[&values, func](std::size_t* i1, std::size_t* i2) {
-				return std::lexicographical_compare(
-					func(values[*i1]).begin(), func(values[*i1]).end(),
-					func(values[*i2]).begin(), func(values[*i2]).end());
-			});
+		// polyBoundaryMesh : "N ( name { type ...; nFaces ...; startFace ...; } ... )"
+		static bool read_boundary(const std::string& path, size_t num_faces, std::vector<patch>& patches) {
+			foam_file foam;
+			if (!open_foam_file(path, foam)) return false;
+			auto fail = [&path]() {
+				std::cerr << "Error: bad boundary file " << path << std::endl;
+				return false;
+				};
+			auto number = [](std::string_view text, auto& value) {
+				auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+				return ec == std::errc() && ptr == text.data() + text.size();
+				};
 
-		// ĵ ε ٽ οմϴ.
-		for (std::size_t i = 0; i < values.size(); ++i) {
-			*indicesPtr[i] = static_cast<std::size_t>(i);
+			size_t n = 0;
+			if (!list_begin(foam, n)) return fail();
+			patches.clear();
+			patches.reserve(n);
+			const char* p = foam.p;
+			const char* end = foam.end;
+			for (size_t i = 0; i < n; ++i) {
+				patch pt;
+				p = skip_foam_space(p, end);
+				const char* name = p;
+				while (p != end && !text_scanner::is_space(*p) && *p != '{') ++p;
+				pt.name.assign(name, p);
+				p = skip_foam_space(p, end);
+				if (pt.name.empty() || p == end || *p != '{') return fail();
+
+				// dictionary body up to the matching '}'
+				const char* body = ++p;
+				int depth = 1;
+				while (p != end && depth > 0) {
+					if (*p == '{') ++depth;
+					else if (*p == '}') --depth;
+					++p;
+				}
+				if (depth != 0) return fail();
+				std::string_view dict(body, p - 1 - body);
+
+				pt.type = std::string(dict_entry(dict, "type"));
+				if (!number(dict_entry(dict, "nFaces"), pt.num_faces) ||
+					!number(dict_entry(dict, "startFace"), pt.start_face)) return fail();
+				auto my_proc = dict_entry(dict, "myProcNo");
+				auto neighb_proc = dict_entry(dict, "neighbProcNo");
+				if (!my_proc.empty() && !number(my_proc, pt.my_proc_no)) return fail();
+				if (!neighb_proc.empty() && !number(neighb_proc, pt.neighb_proc_no)) return fail();
+				if (pt.end_face() > num_faces) {
+					std::cerr << "Error: patch " << pt.name << " runs past the last face in " << path << std::endl;
+					return false;
+				}
+				patches.push_back(std::move(pt));
+			}
+			return true;
 		}
 
-		// ־ Լ ̿Ͽ  Ͽ Ҹ մϴ.
-		std::sort(values.begin(), values.end(), [func](auto& a, auto& b) {
-			return std::lexicographical_compare(
-				func(a).begin(), func(a).end(),
-				func(b).begin(), func(b).end());
-			});
+		//----------------------------------------------
+		// ascii files : the mapped text is tokenized with from_chars, '(' and ')'
+		// count as separators, and long lists are split across threads
 
+		static bool is_list_separator(char c) {
+			return text_scanner::is_space(c) || c == '(' || c == ')';
+		}
 
-		auto approximately_equal_with_epsilon = [](auto a, auto b) {
-			return approximately_equal(a, b, 1.e-12);
-			};
+		// every number in [begin, end); alloc(count, out) points out at storage
+		// for count values or returns false when count is not the expected one
+		template<typename T, typename Alloc>
+		static bool parse_list_numbers(const char* begin, const char* end, Alloc alloc) {
+			constexpr size_t min_block_bytes = 1 << 20;
+			size_t num_blocks = std::max<size_t>(1,
+				std::min(num_threads(), static_cast<size_t>(end - begin) / min_block_bytes));
+			std::vector<const char*> cuts(num_blocks + 1, end);
+			cuts[0] = begin;
+			for (size_t b = 1; b < num_blocks; ++b) {
+				const char* p = std::max(cuts[b - 1], begin + (end - begin) / num_blocks * b);
+				while (p != end && !is_list_separator(*p)) ++p;
+				cuts[b] = p;
+			}
+			// count tokens per block, then parse each block into its slot
+			std::vector<size_t> starts(num_blocks + 1, 0);
+			parallel_for(0, num_blocks, [&](size_t b0, size_t b1) {
+				for (size_t b = b0; b < b1; ++b) {
+					const char* p = cuts[b];
+					const char* e = cuts[b + 1];
+					size_t n = 0;
+					while (true) {
+						while (p != e && is_list_separator(*p)) ++p;
+						if (p == e) break;
+						++n;
+						while (p != e && !is_list_separator(*p)) ++p;
+					}
+					starts[b + 1] = n;
+				}
+				}, 1);
+			for (size_t b = 0; b < num_blocks; ++b) starts[b + 1] += starts[b];
+
+			T* out = nullptr;
+			if (!alloc(starts[num_blocks], out)) return false;
+			std::atomic<bool> ok{ true };
+			parallel_for(0, num_blocks, [&](size_t b0, size_t b1) {
+				for (size_t b = b0; b < b1; ++b) {
+					const char* p = cuts[b];
+					const char* e = cuts[b + 1];
+					for (size_t i = starts[b]; i < starts[b + 1]; ++i) {
+						while (is_list_separator(*p)) ++p;
+						if (*p == '+') ++p;
+						auto [ptr, ec] = std::from_chars(p, e, out[i]);
+						if (ec != std::errc() || (ptr != e && !is_list_separator(*ptr))) {
+							ok = false;
+							return;
+						}
+						p = ptr;
+					}
+				}
+				}, 1);
+			return ok;
+		}
 
-		// ߺ ҿ  ο ε οմϴ.
-		for (std::size_t i = 1, j = 0; i < values.size(); ++i) {
-			if (approximately_equal_with_epsilon(func(values[i - 1]), func(values[i]))) {
-				//indicesPtr[i]->second = true;
-				*indicesPtr[i] = static_cast<std::size_t>(j);
+		// extent of the list "N ( ... )"; items of a nested list hold their own
+		// parentheses, so it closes at the last ')' of the file
+		static bool ascii_list(foam_file& foam, size_t& n, const char*& begin, const char*& end, bool nested) {
+			if (!list_begin(foam, n)) return false;
+			begin = foam.p;
+			if (nested) {
+				size_t at = std::string_view(foam.p, foam.end - foam.p).rfind(')');
+				end = at == std::string_view::npos ? foam.end : foam.p + at;
 			}
 			else {
-				*indicesPtr[i] = static_cast<std::size_t>(++j);
+				end = std::find(foam.p, foam.end, ')');
 			}
+			if (end == foam.end) return false;
+			foam.p = end + 1;
+			return true;
 		}
 
-		// ߺ ҵ մϴ.
-		auto new_end = std::unique(values.begin(), values.end(),
-			[approximately_equal_with_epsilon, func](auto& a, auto& b) {
-				return approximately_equal_with_epsilon(func(a), func(b));
-			});
+		static bool read_ascii_points(foam_file& foam, const std::string& path, pos_t& pos) {
+			size_t n = 0;
+			const char* begin = nullptr;
+			const char* end = nullptr;
+			// interleaved storage is parsed in place, separate x / y / z arrays through a copy
+			using real_type = pos_t::real_type;
+			std::vector<real_type> xyz;
+			bool ok = ascii_list(foam, n, begin, end, true) &&
+				parse_list_numbers<real_type>(begin, end, [&](size_t count, real_type*& out) {
+				if (count != 3 * n) return false;
+				if constexpr (pos_t::soa) {
+					xyz.resize(count);
+					out = xyz.data();
+				}
+				else {
+					pos.resize(n);
+					out = pos.data(0);
+				}
+				return true;
+					});
+			if (ok && pos_t::soa) pos.assign_interleaved(xyz.data(), n);
+			if (!ok) std::cerr << "Error: bad vectorField in " << path << std::endl;
+			return ok;
+		}
 
-		values.erase(new_end, values.end());
+		// faceList "n(v0 ... vn-1)" items, or faceCompactList (offsets list then vertex list)
+		static bool read_ascii_faces(foam_file& foam, const std::string& path, f2v_t& f2v) {
+			auto fail = [&path]() {
+				std::cerr << "Error: bad face list in " << path << std::endl;
+				return false;
+				};
+			const char* begin = nullptr;
+			const char* end = nullptr;
+
+			if (foam.class_name == "faceCompactList") {
+				auto& offsets = f2v.offsets();
+				auto& indices = f2v.indices();
+				size_t num_offsets = 0;
+				size_t num_indices = 0;
+				auto sized = [](auto& v, size_t n) {
+					using value_type = typename std::remove_reference_t<decltype(v)>::value_type;
+					return [&v, n](size_t count, value_type*& out) {
+						if (count != n) return false;
+						v.resize(n);
+						out = v.data();
+						return true;
+						};
+					};
+				if (!ascii_list(foam, num_offsets, begin, end, false) ||
+					!parse_list_numbers<size_t>(begin, end, sized(offsets, num_offsets))) return fail();
+				if (num_offsets == 0) offsets.assign(1, 0);
+				if (!ascii_list(foam, num_indices, begin, end, false)) return fail();
+				if (offsets.front() != 0 || offsets.back() != num_indices ||
+					!std::is_sorted(offsets.begin(), offsets.end())) return fail();
+				if (!parse_list_numbers<index_t>(begin, end, sized(indices, num_indices))) return fail();
+				return true;
+			}
 
-		return indices;
+			// the flat token stream is size, vertices, size, vertices, ... : face i
+			// starts at token offsets[i] + i
+			size_t num_faces = 0;
+			std::vector<size_t> tokens;
+			if (!ascii_list(foam, num_faces, begin, end, true) ||
+				!parse_list_numbers<size_t>(begin, end, [&tokens](size_t count, size_t*& out) {
+					tokens.resize(count);
+					out = tokens.data();
+					return true;
+					})) return fail();
+
+			auto& offsets = f2v.offsets();
+			offsets.resize(num_faces + 1);
+			offsets[0] = 0;
+			size_t at = 0;
+			for (size_t i = 0; i < num_faces; ++i) {
+				if (at >= tokens.size()) return fail();
+				offsets[i + 1] = offsets[i] + tokens[at];
+				at += tokens[at] + 1;
+			}
+			if (at != tokens.size()) return fail();
+
+			// the tokens are size_t : point labels past the index range are
+			// refused before they are narrowed
+			auto& indices = f2v.indices();
+			indices.resize(offsets[num_faces]);
+			std::atomic<bool> ok{ true };
+			parallel_for(0, num_faces, [&](size_t i0, size_t i1) {
+				bool fine = true;
+				for (size_t i = i0; i < i1; ++i) {
+					auto first = tokens.begin() + offsets[i] + i + 1;
+					for (size_t k = 0; k < offsets[i + 1] - offsets[i]; ++k) {
+						fine &= first[k] <= std::numeric_limits<index_t>::max();
+						indices[offsets[i] + k] = static_cast<index_t>(first[k]);
+					}
+				}
+				if (!fine) ok = false;
+				});
+			return ok ? true : fail();
+		}
 
-	}
+		static bool read_ascii_labels(foam_file& foam, const std::string& path, std::vector<index_t>& labels) {
+			size_t n = 0;
+			const char* begin = nullptr;
+			const char* end = nullptr;
+			if (!ascii_list(foam, n, begin, end, false)) {
+				std::cerr << "Error: bad labelList in " << path << std::endl;
+				return false;
+			}
+			auto sized = [n](auto& v) {
+				return [&v, n](size_t count, auto*& out) {
+					if (count != n) return false;
+					v.resize(n);
+					out = v.data();
+					return true;
+					};
+				};
+			if (parse_list_numbers<index_t>(begin, end, sized(labels))) return true;
 
+			// old neighbour files pad the boundary faces with -1
+			std::vector<long long> signed_labels;
+			if (!parse_list_numbers<long long>(begin, end, sized(signed_labels))) {
+				std::cerr << "Error: bad labelList in " << path << std::endl;
+				return false;
+			}
+			auto last = std::find_if(signed_labels.begin(), signed_labels.end(), [](long long v) { return v < 0; });
+			if (std::any_of(signed_labels.begin(), last, [](long long v) {
+				return static_cast<unsigned long long>(v) > std::numeric_limits<index_t>::max(); })) {
+				std::cerr << "Error: label past the " << 8 * sizeof(index_t) << " bit index range in " << path << std::endl;
+				return false;
+			}
+			labels.assign(signed_labels.begin(), last);
+			return true;
+		}
+		//----------------------------------------------
+		// writer
+
+		// face permutation giving OpenFOAM's upper triangular order : internal
+		// faces sorted by (owner, neighbour) with owner < neighbour, then the
+		// boundary faces grouped by patch, in their original order within a patch
+		struct face_order {
+			std::vector<size_t> faces;    // new face i is old face faces[i]
+			std::vector<char> flip;       // per old face : cells swapped, points reversed
+			size_t num_internal = 0;
+			size_t num_cells = 0;
+			std::vector<patch> patches;   // face ranges in the new order
+		};
+
+		struct foam_output {
+			bool binary = false;
+			size_t label_size = 4;
+			std::string note;
+		};
+
+		static bool order_faces(const mesh& msh, face_order& order) {
+			const auto& f2c = msh.f2c;
+			size_t num_faces = f2c.size();
+			order.num_cells = 0;
+			order.flip.assign(num_faces, 0);
+			std::vector<size_t> internal;
+			std::vector<size_t> boundary;
+			for (size_t i = 0; i < num_faces; ++i) {
+				auto cells = f2c[i];
+				if (cells.empty() || cells.size() > 2) {
+					std::cerr << "Error: face " << i << " has " << cells.size() << " cells, OpenFOAM needs 1 or 2" << std::endl;
+					return false;
+				}
+				for (auto c : cells) order.num_cells = std::max<size_t>(order.num_cells, c + 1);
+				if (cells.size() == 2) {
+					internal.push_back(i);
+					order.flip[i] = cells[0] > cells[1];
+				}
+				else {
+					boundary.push_back(i);
+				}
+			}
 
-	////===================================================
+			// group the internal faces by owner (counting sort), then sort each group by neighbour
+			auto lower = [&](size_t f) { return std::min(f2c[f][0], f2c[f][1]); };
+			auto upper = [&](size_t f) { return std::max(f2c[f][0], f2c[f][1]); };
+			auto by_owner = invert_rows<size_t>(internal.size(), order.num_cells, [&](size_t i) {
+				return std::array<size_t, 1>{ lower(internal[i]) };
+				});
+			parallel_for(0, by_owner.size(), [&](size_t c0, size_t c1) {
+				for (size_t c = c0; c < c1; ++c) {
+					auto row = by_owner[c];
+					std::sort(row.begin(), row.end(), [&](size_t a, size_t b) {
+						size_t ua = upper(internal[a]);
+						size_t ub = upper(internal[b]);
+						return ua < ub || (ua == ub && a < b);
+						});
+				}
+				});
+
+			order.num_internal = internal.size();
+			order.faces.resize(num_faces);
+			const auto& sorted = by_owner.indices();
+			parallel_for(0, sorted.size(), [&](size_t i0, size_t i1) {
+				for (size_t i = i0; i < i1; ++i) order.faces[i] = internal[sorted[i]];
+				});
+
+			// boundary faces by patch (counting sort); faces in no patch go to a
+			// trailing defaultFaces wall patch
+			f2p_t ranges;
+			const f2p_t* f2p = &msh.f2p;
+			if (msh.f2p.size() != num_faces) {
+				ranges = f2p_from_patches(msh.patches, num_faces);
+				f2p = &ranges;
+			}
+			size_t num_patches = msh.patches.size();
+			auto by_patch = invert_rows<size_t>(boundary.size(), num_patches + 1, [&](size_t i) {
+				int32_t p = (*f2p)[boundary[i]];
+				return std::array<size_t, 1>{ p < 0 || static_cast<size_t>(p) >= num_patches ? num_patches : static_cast<size_t>(p) };
+				});
+			for (size_t k = 0; k < by_patch.num_entries(); ++k) {
+				order.faces[order.num_internal + k] = boundary[by_patch.indices()[k]];
+			}
+			order.patches = msh.patches;
+			if (!by_patch[num_patches].empty()) order.patches.push_back({ "defaultFaces", "wall" });
+			for (size_t p = 0; p < order.patches.size(); ++p) {
+				order.patches[p].start_face = order.num_internal + by_patch.offsets()[p];
+				order.patches[p].num_faces = by_patch[p].size();
+			}
+
+			size_t num_moved = 0;
+			size_t num_flipped = 0;
+			for (size_t i = 0; i < num_faces; ++i) {
+				num_moved += order.faces[i] != i;
+				num_flipped += order.flip[i];
+			}
+			if (num_moved > 0 || num_flipped > 0) {
+				std::cout << "OpenFOAM output : " << num_moved << " faces reordered and " << num_flipped
+					<< " faces flipped to upper triangular order" << std::endl;
+			}
+			return true;
+		}
+
+		static void write_foam_header(buffered_writer& out, const foam_output& foam,
+			std::string_view class_name, std::string_view object, bool with_note) {
+			out.write("FoamFile\n{\n");
+			out.write("    version     2.0;\n");
+			out.write(foam.binary ? "    format      binary;\n" : "    format      ascii;\n");
+			out.write(std::endian::native == std::endian::big ? "    arch        \"MSB" : "    arch        \"LSB");
+			out.write(foam.label_size == 8 ? ";label=64;scalar=64\";\n" : ";label=32;scalar=64\";\n");
+			out.write("    class       "); out.write(class_name); out.write(";\n");
+			if (with_note) {
+				out.write("    note        \""); out.write(foam.note); out.write("\";\n");
+			}
+			out.write("    location    \"constant/polyMesh\";\n");
+			out.write("    object      "); out.write(object); out.write(";\n");
+			out.write("}\n\n");
+		}
+
+		static void write_label(buffered_writer& out, const foam_output& foam, size_t value) {
+			if (!foam.binary) out.write_number(value);
+			else if (foam.label_size == 8) out.write_value(static_cast<int64_t>(value));
+			else out.write_value(static_cast<int32_t>(value));
+		}
+
+		// "N\n(" : binary data follows directly, ascii items one per line
+		static void write_list_begin(buffered_writer& out, const foam_output& foam, size_t n) {
+			out.write_number(n);
+			out.write("\n(");
+			if (!foam.binary) out.put('\n');
+		}
+
+		// binary vectorField of doubles (scalar=64 in the header), written straight
+		// from interleaved double storage, converted in chunks otherwise
+		static void write_binary_points(buffered_writer& out, const pos_t& pos) {
+			if constexpr (!pos_t::soa && std::is_same_v<pos_t::real_type, double>) {
+				out.write(pos.data(0), pos.size() * 3 * sizeof(double));
+			}
+			else {
+				constexpr size_t chunk = 1 << 14;
+				std::vector<double> xyz(3 * chunk);
+				for (size_t i0 = 0; i0 < pos.size(); i0 += chunk) {
+					size_t i1 = std::min(pos.size(), i0 + chunk);
+					for (size_t i = i0; i < i1; ++i) {
+						for (int k = 0; k < 3; ++k) xyz[3 * (i - i0) + k] = pos[i][k];
+					}
+					out.write(xyz.data(), 3 * (i1 - i0) * sizeof(double));
+				}
+			}
+		}
+
+		static bool write_points(const std::string& path, const foam_output& foam, const pos_t& pos) {
+			buffered_writer out(path);
+			if (!out.is_open()) return false;
+			write_foam_header(out, foam, "vectorField", "points", false);
+			write_list_begin(out, foam, pos.size());
+			if (foam.binary) {
+				if (!pos.empty()) write_binary_points(out, pos);
+			}
+			else {
+				for (const auto& p : pos) {
+					out.put('(');
+					out.write_number(p[0]); out.put(' ');
+					out.write_number(p[1]); out.put(' ');
+					out.write_number(p[2]);
+					out.write(")\n");
+				}
+			}
+			out.write(")\n");
+			out.close();
+			return out.good();
+		}
+
+		static bool write_faces(const std::string& path, const foam_output& foam, const mesh& msh,
+			const face_order& order, bool compact) {
+			buffered_writer out(path);
+			if (!out.is_open()) return false;
+			size_t num_faces = order.faces.size();
+			// points of new face i, reversed for flipped faces
+			auto for_points = [&](size_t i, auto&& emit) {
+				size_t f = order.faces[i];
+				auto points = msh.f2v[f];
+				if (order.flip[f]) {
+					for (size_t k = points.size(); k-- > 0;) emit(points[k]);
+				}
+				else {
+					for (auto v : points) emit(v);
+				}
+				};
+
+			if (compact) {
+				char sep = foam.binary ? '\0' : '\n';
+				write_foam_header(out, foam, "faceCompactList", "faces", false);
+				write_list_begin(out, foam, num_faces + 1);
+				size_t offset = 0;
+				write_label(out, foam, offset);
+				if (sep) out.put(sep);
+				for (size_t i = 0; i < num_faces; ++i) {
+					offset += msh.f2v[order.faces[i]].size();
+					write_label(out, foam, offset);
+					if (sep) out.put(sep);
+				}
+				out.write(")\n\n");
+				write_list_begin(out, foam, msh.f2v.num_entries());
+				for (size_t i = 0; i < num_faces; ++i) {
+					for_points(i, [&](size_t v) {
+						write_label(out, foam, v);
+						if (sep) out.put(sep);
+						});
+				}
+				out.write(")\n");
+			}
+			else {
+				write_foam_header(out, foam, "faceList", "faces", false);
+				write_list_begin(out, foam, num_faces);
+				if (foam.binary) out.put('\n');
+				for (size_t i = 0; i < num_faces; ++i) {
+					out.write_number(msh.f2v[order.faces[i]].size());
+					out.put('(');
+					bool first = true;
+					for_points(i, [&](size_t v) {
+						if (!foam.binary && !first) out.put(' ');
+						write_label(out, foam, v);
+						first = false;
+						});
+					out.write(")\n");
+				}
+				out.write(")\n");
+			}
+			out.close();
+			return out.good();
+		}
+
+		// side 0 : owner of every face, side 1 : neighbour of the internal faces
+		static bool write_cells(const std::string& path, const foam_output& foam, const mesh& msh,
+			const face_order& order, size_t side) {
+			buffered_writer out(path);
+			if (!out.is_open()) return false;
+			size_t n = side == 0 ? order.faces.size() : order.num_internal;
+			write_foam_header(out, foam, "labelList", side == 0 ? "owner" : "neighbour", true);
+			write_list_begin(out, foam, n);
+			for (size_t i = 0; i < n; ++i) {
+				size_t f = order.faces[i];
+				write_label(out, foam, msh.f2c[f][side ^ static_cast<size_t>(order.flip[f])]);
+				if (!foam.binary) out.put('\n');
+			}
+			out.write(")\n");
+			out.close();
+			return out.good();
+		}
+
+		static bool write_boundary(const std::string& path, const face_order& order) {
+			buffered_writer out(path);
+			if (!out.is_open()) return false;
+			foam_output foam;
+			write_foam_header(out, foam, "polyBoundaryMesh", "boundary", false);
+			out.write_number(order.patches.size());
+			out.write("\n(\n");
+			for (auto& pt : order.patches) {
+				out.write("    "); out.write(pt.name); out.write("\n    {\n");
+				out.write("        type            "); out.write(pt.type.empty() ? "patch" : pt.type); out.write(";\n");
+				if (pt.type == "wall") out.write("        inGroups        List<word> 1(wall);\n");
+				out.write("        nFaces          "); out.write_number(pt.num_faces); out.write(";\n");
+				out.write("        startFace       "); out.write_number(pt.start_face); out.write(";\n");
+				if (pt.my_proc_no >= 0) {
+					out.write("        myProcNo        "); out.write_number(pt.my_proc_no); out.write(";\n");
+					out.write("        neighbProcNo    "); out.write_number(pt.neighb_proc_no); out.write(";\n");
+				}
+				out.write("    }\n");
+			}
+			out.write(")\n");
+			out.close();
+			return out.good();
+		}
+
+		std::optional<bool> compact_faces_;
+	};
+
+
+
+
+
+
+
+
+
+	class vtu_mesh_io : public mesh_io_base {
+	public:
+		load_t load(std::string fileName) override {
+			return load(fileName, {});
+		}
+
+		// reads only the named arrays ("Points", "connectivity", "offsets", "types",
+		// "faces", "faceoffsets"); an empty list reads everything. Cells that share a
+		// face each keep their own copy of it in f2v.
+		load_t load(std::string fileName, std::vector<std::string> arrays) {
+
+			load_t load_func;
+
+			load_func = [fileName, arrays](mesh& msh) {
+				read_file(fileName, arrays, msh);
+				};
+
+			return load_func;
+		}
+
+		// load without the deferred call; false when the file could not be read
+		static bool read_file(const std::string& fileName, const std::vector<std::string>& arrays, mesh& msh) {
+
+			mapped_file file(fileName);
+			if (!file.is_open()) {
+				std::cerr << "Error: Cannot open file " << fileName << '\n';
+				return false;
+			}
+
+			auto wanted = [&arrays](std::string_view name) {
+				return arrays.empty() || std::find(arrays.begin(), arrays.end(), name) != arrays.end();
+				};
+
+			vtu_file vtu;
+			if (!scan_vtu(file, vtu)) {
+				std::cerr << "Error: " << fileName << " is not a readable VTU UnstructuredGrid" << std::endl;
+				return false;
+			}
+
+			// cells come with their own points and faces : kept as the mesh's
+			// c2v / c2f instead of being derived again
+			c2f_t c2f = msh.c2f();
+			c2v_t c2v = msh.c2v();
+			for (auto& piece : vtu.pieces) {
+				if (!read_piece(vtu, piece, wanted, msh, c2f, c2v)) {
+					std::cerr << "Error: failed to read " << fileName << std::endl;
+					return false;
+				}
+			}
+			msh.set_c2f(std::move(c2f));
+			msh.set_c2v(std::move(c2v));
+
+			std::cout << "Complete Load VTU mesh from " << fileName << std::endl;
+			return true;
+		}
+		save_t save(std::string fileName) override {
+			save_t save_func;
+
+
+
+			save_func = [fileName, format = format_](mesh& msh) {
+				write_file(fileName, format, msh);
+				};
+
+
+
+			std::cout << "Saving OBJ mesh to " << std::endl;
+			return save_func;
+		}
+
+		// raw binary in an AppendedData block unless ascii or base64 is asked
+		// for; false when the file could not be written
+		static bool write_file(const std::string& fileName, data_format format, const mesh& msh) {
+
+			buffered_writer out(fileName);
+			if (!out.is_open()) {
+				std::cerr << "Unable to write file for writing." << std::endl;
+				return false;
+			}
+
+			vtu_encoding encoding = vtu_encoding::appended;
+			if (format == data_format::ascii) encoding = vtu_encoding::ascii;
+			if (format == data_format::base64) encoding = vtu_encoding::base64;
+
+			// volume cells are polyhedra; a mesh without cells (STL, OBJ, ...)
+			// writes every face as a polygon cell instead
+			const auto& c2f = msh.c2f();
+			bool surface = c2f.empty();
+			const auto& c2v = surface ? msh.f2v : msh.c2v();
+			uint8_t cell_type = surface ? 7 : 42;
+
+			// polyhedron face stream : per cell the face count, then per face its size and points
+			size_t num_face_stream = 0;
+			for (auto cell : c2f) {
+				num_face_stream += 1 + cell.size();
+				for (auto f : cell) num_face_stream += msh.f2v[f].size();
+			}
+
+			std::vector<data_array> points_arrays;
+			points_arrays.push_back({ "Float64", "NodeCoordinates", 3, 3 * msh.pos.size(), sizeof(double),
+				[&](value_writer& emit) {
+					for (const auto& p : msh.pos) {
+						emit(p[0]); emit(p[1]); emit(p[2]);
+					}
+				} });
+
+			std::vector<data_array> cells_arrays;
+			// connectivity (cell's points)
+			cells_arrays.push_back({ "Int64", "connectivity", 1, c2v.num_entries(), sizeof(int64_t),
+				[&](value_writer& emit) {
+					for (auto i : c2v.indices()) emit(static_cast<int64_t>(i));
+				} });
+			// offsets (cell's points offset)
+			cells_arrays.push_back({ "Int64", "offsets", 1, c2v.size(), sizeof(int64_t),
+				[&](value_writer& emit) {
+					for (size_t c = 0; c < c2v.size(); ++c) emit(static_cast<int64_t>(c2v.offsets()[c + 1]));
+				} });
+			// types (cell's type, 42 = polyhedron, 7 = polygon)
+			cells_arrays.push_back({ "UInt8", "types", 1, c2v.size(), sizeof(uint8_t),
+				[&](value_writer& emit) {
+					for (size_t c = 0; c < c2v.size(); ++c) emit(cell_type);
+				} });
+			if (!surface) {
+				// faces (cell's faces number, each face's point number, cell's faces's points)
+				cells_arrays.push_back({ "Int64", "faces", 1, num_face_stream, sizeof(int64_t),
+					[&](value_writer& emit) {
+						for (auto cell : c2f) {
+							emit(static_cast<int64_t>(cell.size()));
+							for (auto f : cell) {
+								emit(static_cast<int64_t>(msh.f2v[f].size()));
+								for (auto v : msh.f2v[f]) emit(static_cast<int64_t>(v));
+							}
+						}
+					}, true });
+				cells_arrays.push_back({ "Int64", "faceoffsets", 1, c2f.size(), sizeof(int64_t),
+					[&](value_writer& emit) {
+						int64_t cellFacePointOffset = 0;
+						for (auto cell : c2f) {
+							cellFacePointOffset += 1;
+							for (auto f : cell) cellFacePointOffset += 1 + msh.f2v[f].size();
+							emit(cellFacePointOffset);
+						}
+					}, true });
+			}
+
+			out.write("<?xml version=\"1.0\"?>\n");
+			out.write(" <VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt64\">\n");
+			out.write("  <UnstructuredGrid>\n");
+			out.write("   <Piece NumberOfPoints=\"" + std::to_string(msh.pos.size()) +
+				"\" NumberOfCells=\"" + std::to_string(c2v.size()) + "\">\n");
+
+			// Points data
+			out.write("    <PointData>\n");
+			out.write("    </PointData>\n");
+			// Cells data
+			out.write("    <CellData>\n");
+			out.write("    </CellData>\n");
+
+			uint64_t appended_offset = 0;
+			out.write("    <Points>\n");
+			for (auto& a : points_arrays) write_data_array(out, encoding, a, appended_offset);
+			out.write("   </Points>\n");
+
+			out.write("   <Cells>\n");
+			for (auto& a : cells_arrays) write_data_array(out, encoding, a, appended_offset);
+			out.write("   </Cells>\n");
+
+			out.write("  </Piece>\n");
+			out.write(" </UnstructuredGrid>\n");
+
+			// raw blocks : UInt64 byte count followed by the values
+			if (encoding == vtu_encoding::appended) {
+				out.write(" <AppendedData encoding=\"raw\">\n  _");
+				value_writer emit(out, encoding, 1);
+				for (auto* arrays : { &points_arrays, &cells_arrays }) {
+					for (auto& a : *arrays) {
+						out.write_value(static_cast<uint64_t>(a.num_values * a.value_size));
+						a.generate(emit);
+					}
+				}
+				out.write("\n </AppendedData>\n");
+			}
+
+
+
+
+
+			//// additional informations
+			//{
+			//	string saveFormat = "ascii";
+			//	outputFile << " <DataArray type=\"Int32\" Name=\"owner\" format=\"" << saveFormat << "\">" << endl;
+			//	// vector<int> values;
+			//	for (auto& face : mesh.faces) {
+			//		// values.push_back(face.owner);
+			//		outputFile << face.iL << " ";
+			//	}
+			//	// writeDatasAtVTU(controls, outputFile, values);
+			//	outputFile << endl;
+			//	outputFile << " </DataArray>" << endl;
+			//}
+			//{
+			//	string saveFormat = "ascii";
+			//	outputFile << " <DataArray type=\"Int32\" Name=\"neighbour\" format=\"" << saveFormat << "\">" << endl;
+			//	// vector<int> values;
+			//	for (auto& face : mesh.faces) {
+			//		// values.push_back(face.neighbour);
+			//		if (face.getType() == MASCH_Face_Types::INTERNAL) {
+			//			outputFile << face.iR << " ";
+			//		}
+			//	}
+			//	// writeDatasAtVTU(controls, outputFile, values);
+			//	outputFile << endl;
+			//	outputFile << " </DataArray>" << endl;
+			//}
+
+
+
+			//// boundary informations
+			//{
+			//	outputFile << " <DataArray type=\"Char\" Name=\"bcName\" format=\"" << "ascii" << "\">" << endl;
+			//	// for(auto& boundary : mesh.boundary){
+			//		// // cout << boundary.name << endl;
+			//		// // trim;
+			//		// string bcName = boundary.name;
+
+			//		// bcName.erase(std::find_if(bcName.rbegin(), bcName.rend(), std::not1(std::ptr_fun<int, int>(std::isspace))).base(), bcName.end());
+			//		// bcName.erase(bcName.begin(), std::find_if(bcName.begin(), bcName.end(), std::not1(std::ptr_fun<int, int>(std::isspace))));
+
+
+			//		// // outputFile << boundary.name << " ";
+			//		// outputFile << bcName << " ";
+			//	// }
+			//	for (auto& boundary : mesh.boundaries) {
+			//		// cout << boundary.name << endl;
+			//		outputFile << boundary.name << " ";
+			//	}
+			//	outputFile << endl;
+			//	outputFile << " </DataArray>" << endl;
+
+			//	outputFile << " <DataArray type=\"Int32\" Name=\"bcStartFace\" format=\"" << "ascii" << "\">" << endl;
+			//	for (auto& boundary : mesh.boundaries) {
+			//		outputFile << boundary.startFace << " ";
+			//	}
+			//	outputFile << endl;
+			//	outputFile << " </DataArray>" << endl;
+
+			//	outputFile << " <DataArray type=\"Int32\" Name=\"bcNFaces\" format=\"" << "ascii" << "\">" << endl;
+			//	for (auto& boundary : mesh.boundaries) {
+			//		outputFile << boundary.nFaces << " ";
+			//	}
+			//	outputFile << endl;
+			//	outputFile << " </DataArray>" << endl;
+
+			//	outputFile << " <DataArray type=\"Int32\" Name=\"bcNeighbProcNo\" format=\"" << "ascii" << "\">" << endl;
+			//	for (auto& boundary : mesh.boundaries) {
+			//		// cout << boundary.rightProcNo << endl;
+			//		outputFile << boundary.rightProcNo << " ";
+			//	}
+			//	outputFile << endl;
+			//	outputFile << " </DataArray>" << endl;
+
+			//	outputFile << " <DataArray type=\"Int32\" Name=\"connPoints\" format=\"" << "ascii" << "\">" << endl;
+			//	for (int i = 0; i < mesh.points.size(); ++i) {
+			//		auto& point = mesh.points[i];
+			//		for (auto& [item, item2] : point.connPoints) {
+			//			outputFile << i << " " << item << " " << item2 << " ";
+			//		}
+			//		// if(!point.connPoints.empty()) outputFile << endl;
+			//	}
+			//	outputFile << endl;
+			//	outputFile << " </DataArray>" << endl;
+
+
+			//}
+
+			out.write("</VTKFile>\n");
+
+			out.close();
+			if (!out.good()) {
+				std::cerr << "Error: writing " << fileName << " failed" << std::endl;
+				return false;
+			}
+
+			// }
+
+
+
+
+
+
+
+
+
+			std::cout << "  Ǿϴ." << std::endl;
+			return true;
+		}
+
+	private:
+		//----------------------------------------------
+		// reader
+
+		// where a DataArray's values live in the mapped file
+		struct array_ref {
+			std::string_view type;
+			std::string_view format;
+			size_t num_components = 1;
+			size_t offset = 0;                  // appended arrays
+			const char* content = nullptr;      // inline arrays
+			const char* content_end = nullptr;
+		};
+
+		struct piece_ref {
+			size_t num_points = 0;
+			size_t num_cells = 0;
+			std::map<std::string, array_ref, std::less<>> arrays;
+		};
+
+		struct vtu_file {
+			bool big_endian = false;
+			size_t header_size = 4;             // UInt32 unless header_type says UInt64
+			bool appended_base64 = false;
+			const char* appended = nullptr;     // byte after '_'
+			const char* end = nullptr;
+			std::vector<piece_ref> pieces;
+		};
+
+		// one pass over the tags, recording array locations; inline content is
+		// skipped with a search for the next '<' and appended data is not touched
+		static bool scan_vtu(const mapped_file& file, vtu_file& vtu) {
+			const char* begin = file.data();
+			vtu.end = begin + file.size();
+			xml_scanner xml(begin, vtu.end);
+			xml_tag tag;
+			bool grid = false;
+			std::string_view section;
+			while (xml.next(tag)) {
+				if (tag.name == "VTKFile" && !tag.closing) {
+					if (tag.attribute("type") != "UnstructuredGrid") return false;
+					if (!tag.attribute("compressor").empty()) {
+						std::cerr << "Error: compressed VTU data is not supported" << std::endl;
+						return false;
+					}
+					vtu.big_endian = tag.attribute("byte_order") == "BigEndian";
+					vtu.header_size = tag.attribute("header_type") == "UInt64" ? 8 : 4;
+				}
+				else if (tag.name == "UnstructuredGrid") {
+					grid = !tag.closing;
+				}
+				else if (tag.name == "Piece" && !tag.closing && grid) {
+					piece_ref piece;
+					std::from_chars(tag.attribute("NumberOfPoints").data(),
+						tag.attribute("NumberOfPoints").data() + tag.attribute("NumberOfPoints").size(), piece.num_points);
+					std::from_chars(tag.attribute("NumberOfCells").data(),
+						tag.attribute("NumberOfCells").data() + tag.attribute("NumberOfCells").size(), piece.num_cells);
+					vtu.pieces.push_back(std::move(piece));
+				}
+				else if ((tag.name == "Points" || tag.name == "Cells" ||
+					tag.name == "PointData" || tag.name == "CellData") && !vtu.pieces.empty()) {
+					section = tag.closing || tag.self_closing ? std::string_view() : tag.name;
+				}
+				else if (tag.name == "DataArray" && !tag.closing && !section.empty()) {
+					array_ref a;
+					a.type = tag.attribute("type");
+					a.format = tag.attribute("format");
+					auto comps = tag.attribute("NumberOfComponents");
+					if (!comps.empty()) std::from_chars(comps.data(), comps.data() + comps.size(), a.num_components);
+					auto offset = tag.attribute("offset");
+					if (!offset.empty()) std::from_chars(offset.data(), offset.data() + offset.size(), a.offset);
+					if (!tag.self_closing) {
+						a.content = tag.end;
+						a.content_end = std::find(tag.end, vtu.end, '<');
+						xml.seek(a.content_end);
+					}
+					// the single Points array may have any name
+					std::string name = section == "Points" ? "Points" : std::string(tag.attribute("Name"));
+					if (section == "Points" || section == "Cells") {
+						vtu.pieces.back().arrays[name] = a;
+					}
+				}
+				else if (tag.name == "AppendedData" && !tag.closing) {
+					vtu.appended_base64 = tag.attribute("encoding") == "base64";
+					vtu.appended = std::find(tag.end, vtu.end, '_');
+					if (vtu.appended != vtu.end) ++vtu.appended;
+					break;
+				}
+			}
+			return !vtu.pieces.empty();
+		}
+
+		// raw little/big endian values of a VTK type into Out
+		template<typename Out>
+		static bool convert_raw(std::string_view type, const unsigned char* data, size_t num_bytes,
+			bool swap, std::vector<Out>& out) {
+			auto run = [&](auto tag) {
+				using Src = decltype(tag);
+				out.resize(num_bytes / sizeof(Src));
+				convert_values<Src>(data, out.size(), swap, out.data());
+				return true;
+				};
+			if (type == "Float32") return run(float{});
+			if (type == "Float64") return run(double{});
+			if (type == "Int8") return run(int8_t{});
+			if (type == "UInt8") return run(uint8_t{});
+			if (type == "Int16") return run(int16_t{});
+			if (type == "UInt16") return run(uint16_t{});
+			if (type == "Int32") return run(int32_t{});
+			if (type == "UInt32") return run(uint32_t{});
+			if (type == "Int64") return run(int64_t{});
+			if (type == "UInt64") return run(uint64_t{});
+			std::cerr << "Error: unsupported VTU data type " << type << std::endl;
+			return false;
+		}
+
+		static bool read_header(const vtu_file& vtu, const unsigned char* bytes, size_t& num_bytes) {
+			unsigned char h[8]{};
+			std::memcpy(h, bytes, vtu.header_size);
+			if (vtu.big_endian) std::reverse(h, h + vtu.header_size);
+			if (vtu.header_size == 8) {
+				uint64_t n;
+				std::memcpy(&n, h, 8);
+				num_bytes = static_cast<size_t>(n);
+			}
+			else {
+				uint32_t n;
+				std::memcpy(&n, h, 4);
+				num_bytes = n;
+			}
+			return true;
+		}
+
+		// base64 block : header and data are either encoded separately (VTK) or together
+		static bool decode_base64_block(const vtu_file& vtu, const char* text, const char* text_end,
+			std::vector<unsigned char>& data) {
+			unsigned char header[8]{};
+			const char* after = base64_decode(text, text_end, vtu.header_size, header);
+			if (!after) return false;
+			size_t num_bytes = 0;
+			read_header(vtu, header, num_bytes);
+			data.resize(num_bytes);
+			if (*(after - 1) == '=') {
+				return base64_decode(after, text_end, num_bytes, data.data()) != nullptr;
+			}
+			std::vector<unsigned char> joined(vtu.header_size + num_bytes);
+			if (!base64_decode(text, text_end, joined.size(), joined.data())) return false;
+			std::copy(joined.begin() + vtu.header_size, joined.end(), data.begin());
+			return true;
+		}
+
+		template<typename Out>
+		static bool decode_array(const vtu_file& vtu, const array_ref& a, std::vector<Out>& out) {
+			if (a.format == "ascii") {
+				if (!a.content) return false;
+				return parse_numbers(a.content, a.content_end, out);
+			}
+			if (a.format == "binary") {
+				if (!a.content) return false;
+				std::vector<unsigned char> data;
+				if (!decode_base64_block(vtu, a.content, a.content_end, data)) return false;
+				return convert_raw(a.type, data.data(), data.size(), vtu.big_endian, out);
+			}
+			if (a.format == "appended") {
+				if (!vtu.appended || vtu.appended + a.offset >= vtu.end) return false;
+				const char* at = vtu.appended + a.offset;
+				if (vtu.appended_base64) {
+					std::vector<unsigned char> data;
+					if (!decode_base64_block(vtu, at, vtu.end, data)) return false;
+					return convert_raw(a.type, data.data(), data.size(), vtu.big_endian, out);
+				}
+				if (at + vtu.header_size > vtu.end) return false;
+				size_t num_bytes = 0;
+				read_header(vtu, reinterpret_cast<const unsigned char*>(at), num_bytes);
+				if (at + vtu.header_size + num_bytes > vtu.end) return false;
+				return convert_raw(a.type, reinterpret_cast<const unsigned char*>(at + vtu.header_size),
+					num_bytes, vtu.big_endian, out);
+			}
+			std::cerr << "Error: unsupported DataArray format " << a.format << std::endl;
+			return false;
+		}
+
+		// outward faces of the linear VTK cell types, in VTK point order
+		static const std::vector<std::vector<size_t>>* cell_faces(uint8_t type) {
+			static const std::vector<std::vector<size_t>> tetra{
+				{0, 1, 3}, {1, 2, 3}, {2, 0, 3}, {0, 2, 1} };
+			static const std::vector<std::vector<size_t>> voxel{
+				{0, 4, 6, 2}, {1, 3, 7, 5}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 2, 3, 1}, {4, 5, 7, 6} };
+			static const std::vector<std::vector<size_t>> hexahedron{
+				{0, 4, 7, 3}, {1, 2, 6, 5}, {0, 1, 5, 4}, {3, 7, 6, 2}, {0, 3, 2, 1}, {4, 5, 6, 7} };
+			static const std::vector<std::vector<size_t>> wedge{
+				{0, 1, 2}, {3, 5, 4}, {0, 3, 4, 1}, {1, 4, 5, 2}, {2, 5, 3, 0} };
+			static const std::vector<std::vector<size_t>> pyramid{
+				{0, 3, 2, 1}, {0, 1, 4}, {1, 2, 4}, {2, 3, 4}, {3, 0, 4} };
+			switch (type) {
+			case 10: return &tetra;
+			case 11: return &voxel;
+			case 12: return &hexahedron;
+			case 13: return &wedge;
+			case 14: return &pyramid;
+			default: return nullptr;
+			}
+		}
+
+		static bool is_surface_cell(uint8_t type) {
+			return type == 5 || type == 7 || type == 8 || type == 9;
+		}
+
+		// appends one piece to msh, c2f and c2v; on failure they are cut back
+		// to what they held before
+		template<typename Wanted>
+		static bool read_piece(const vtu_file& vtu, const piece_ref& piece, Wanted wanted, mesh& msh,
+			c2f_t& c2f, c2v_t& c2v) {
+			size_t pos0 = msh.pos.size();
+			size_t face0 = msh.f2v.size();
+			size_t f2c0 = msh.f2c.size();
+			size_t cell0 = c2f.size();
+			size_t c2v0 = c2v.size();
+			if (append_piece(vtu, piece, wanted, msh, c2f, c2v)) return true;
+
+			auto truncate = [](auto& rows, size_t n) {
+				rows.offsets().resize(n + 1);
+				rows.indices().resize(rows.offsets().back());
+				};
+			msh.pos.resize(pos0);
+			truncate(msh.f2v, face0);
+			truncate(msh.f2c, f2c0);
+			truncate(c2f, cell0);
+			truncate(c2v, c2v0);
+			return false;
+		}
+
+		template<typename Wanted>
+		static bool append_piece(const vtu_file& vtu, const piece_ref& piece, Wanted wanted, mesh& msh,
+			c2f_t& c2f, c2v_t& c2v) {
+
+			auto find = [&](std::string_view name) -> const array_ref* {
+				if (!wanted(name)) return nullptr;
+				auto it = piece.arrays.find(name);
+				return it == piece.arrays.end() ? nullptr : &it->second;
+				};
+			const array_ref* points = find("Points");
+			const array_ref* connectivity = find("connectivity");
+			const array_ref* offsets = find("offsets");
+			const array_ref* types = find("types");
+			const array_ref* faces = find("faces");
+			const array_ref* faceoffsets = find("faceoffsets");
+			if (!fits_index(msh.pos.size() + piece.num_points, "points") ||
+				!fits_index(c2f.size() + piece.num_cells, "cells")) return false;
+
+			// decode the selected arrays concurrently
+			std::vector<pos_t::real_type> xyz;
+			std::vector<int64_t> conn, offs, face_stream, face_offs;
+			std::vector<uint8_t> cell_types;
+			std::vector<std::function<bool()>> jobs;
+			if (points) jobs.push_back([&]() { return decode_array(vtu, *points, xyz); });
+			if (connectivity) jobs.push_back([&]() { return decode_array(vtu, *connectivity, conn); });
+			if (offsets) jobs.push_back([&]() { return decode_array(vtu, *offsets, offs); });
+			if (types) jobs.push_back([&]() { return decode_array(vtu, *types, cell_types); });
+			if (faces) jobs.push_back([&]() { return decode_array(vtu, *faces, face_stream); });
+			if (faceoffsets) jobs.push_back([&]() { return decode_array(vtu, *faceoffsets, face_offs); });
+			std::vector<char> done(jobs.size(), 0);
+			parallel_for(0, jobs.size(), [&](size_t j0, size_t j1) {
+				for (size_t j = j0; j < j1; ++j) done[j] = jobs[j]();
+				}, 1);
+			if (std::find(done.begin(), done.end(), 0) != done.end()) return false;
+
+			size_t pos0 = msh.pos.size();
+			if (points) {
+				if (xyz.size() != 3 * piece.num_points) return false;
+				msh.pos.resize(pos0 + piece.num_points);
+				parallel_for(0, piece.num_points, [&](size_t i0, size_t i1) {
+					for (size_t i = i0; i < i1; ++i) {
+						msh.pos.set(pos0 + i, xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]);
+					}
+					});
+			}
+
+			if (!connectivity || !offsets) return true;
+			size_t num_cells = piece.num_cells;
+			if (offs.size() != num_cells) return false;
+			for (size_t c = 0; c < num_cells; ++c) {
+				int64_t start = c == 0 ? 0 : offs[c - 1];
+				if (offs[c] < start || static_cast<size_t>(offs[c]) > conn.size()) return false;
+			}
+			for (auto v : conn) {
+				if (v < 0 || static_cast<size_t>(v) >= piece.num_points) return false;
+			}
+			auto cell_points = [&](size_t c) {
+				size_t start = c == 0 ? 0 : static_cast<size_t>(offs[c - 1]);
+				return std::span<const int64_t>(conn.data() + start, static_cast<size_t>(offs[c]) - start);
+				};
+			auto type_of = [&](size_t c) -> uint8_t {
+				if (c < cell_types.size()) return cell_types[c];
+				return faces ? 42 : 0;
+				};
+
+			// polygons only : a surface mesh, cells become faces
+			bool surface = num_cells > 0;
+			for (size_t c = 0; c < num_cells && surface; ++c) {
+				surface = is_surface_cell(type_of(c));
+			}
+			if (surface) {
+				for (size_t c = 0; c < num_cells; ++c) {
+					auto cp = cell_points(c);
+					msh.f2v.emplace_back();
+					if (type_of(c) == 8) {
+						// pixel point order
+						if (cp.size() != 4) return false;
+						for (size_t i : { 0, 1, 3, 2 }) msh.f2v.append_to_back(pos0 + cp[i]);
+					}
+					else {
+						for (auto v : cp) msh.f2v.append_to_back(pos0 + v);
+					}
+				}
+				return true;
+			}
+
+			size_t cell0 = c2v.size();
+			for (size_t c = 0; c < num_cells; ++c) {
+				c2v.emplace_back();
+				for (auto v : cell_points(c)) c2v.append_to_back(pos0 + v);
+			}
+
+			// faces of every cell, from the polyhedron face stream or the cell type
+			int64_t stream_end = 0;
+			for (size_t c = 0; c < num_cells; ++c) {
+				uint8_t type = type_of(c);
+				c2f.emplace_back();
+				auto add_face = [&](auto&& points) {
+					c2f.append_to_back(msh.f2v.size());
+					msh.f2v.push_back(points);
+					msh.f2c.push_back({ static_cast<index_t>(cell0 + c) });
+					};
+				if (type == 42) {
+					if (c >= face_offs.size() || face_offs[c] < 0) return false;
+					size_t at = static_cast<size_t>(stream_end);
+					stream_end = face_offs[c];
+					if (static_cast<size_t>(stream_end) > face_stream.size() || at >= face_stream.size()) return false;
+					size_t num_faces = static_cast<size_t>(face_stream[at++]);
+					std::vector<size_t> points;
+					for (size_t f = 0; f < num_faces; ++f) {
+						if (at >= static_cast<size_t>(stream_end)) return false;
+						size_t n = static_cast<size_t>(face_stream[at++]);
+						if (at + n > static_cast<size_t>(stream_end)) return false;
+						points.clear();
+						for (size_t i = 0; i < n; ++i) {
+							int64_t v = face_stream[at++];
+							if (v < 0 || static_cast<size_t>(v) >= piece.num_points) return false;
+							points.push_back(pos0 + static_cast<size_t>(v));
+						}
+						add_face(points);
+					}
+				}
+				else if (auto table = cell_faces(type)) {
+					auto cp = cell_points(c);
+					std::vector<size_t> points;
+					for (auto& local : *table) {
+						points.clear();
+						for (auto i : local) {
+							if (i >= cp.size()) return false;
+							points.push_back(pos0 + static_cast<size_t>(cp[i]));
+						}
+						add_face(points);
+					}
+				}
+				if (c < face_offs.size() && face_offs[c] >= 0) stream_end = face_offs[c];
+			}
+			return fits_index(msh.f2v.size(), "faces");
+		}
+
+		//----------------------------------------------
+		// writer
+		enum class vtu_encoding { ascii, base64, appended };
+
+		// sends array values to the file in the chosen encoding
+		class value_writer {
+		public:
+			value_writer(buffered_writer& out, vtu_encoding encoding, size_t values_per_line)
+				: out_(out), base64_(out), encoding_(encoding), values_per_line_(values_per_line) {}
+
+			template<typename T>
+			void operator()(T value) {
+				switch (encoding_) {
+				case vtu_encoding::ascii:
+					if constexpr (sizeof(T) == 1) {
+						out_.write_number(static_cast<int>(value));
+					}
+					else {
+						out_.write_number(value);
+					}
+					out_.put(++count_ % values_per_line_ == 0 ? '\n' : ' ');
+					break;
+				case vtu_encoding::base64:
+					base64_.write_value(value);
+					break;
+				case vtu_encoding::appended:
+					out_.write_value(value);
+					break;
+				}
+			}
+
+			base64_encoder& base64() { return base64_; }
+
+		private:
+			buffered_writer& out_;
+			base64_encoder base64_;
+			vtu_encoding encoding_;
+			size_t values_per_line_;
+			size_t count_ = 0;
+		};
+
+		struct data_array {
+			std::string type;
+			std::string name;
+			size_t num_components;
+			size_t num_values;
+			size_t value_size;
+			std::function<void(value_writer&)> generate;
+			bool id_type = false;
+		};
+
+		// DataArray element; appended arrays only get their offset here
+		static void write_data_array(buffered_writer& out, vtu_encoding encoding,
+			const data_array& a, uint64_t& appended_offset) {
+			out.write("     <DataArray type=\"" + a.type + "\"");
+			if (a.id_type) out.write(" IdType=\"1\"");
+			out.write(" Name=\"" + a.name + "\"");
+			if (a.num_components != 1) {
+				out.write(" NumberOfComponents=\"" + std::to_string(a.num_components) + "\"");
+			}
+			switch (encoding) {
+			case vtu_encoding::ascii: {
+				out.write(" format=\"ascii\">\n");
+				value_writer emit(out, encoding, a.num_components == 1 ? 16 : a.num_components);
+				a.generate(emit);
+				out.write("\n     </DataArray>\n");
+				break;
+			}
+			case vtu_encoding::base64: {
+				// header and data are encoded as two separate base64 blocks
+				out.write(" format=\"binary\">\n");
+				value_writer emit(out, encoding, 1);
+				emit.base64().write_value(static_cast<uint64_t>(a.num_values * a.value_size));
+				emit.base64().finish();
+				a.generate(emit);
+				emit.base64().finish();
+				out.write("\n     </DataArray>\n");
+				break;
+			}
+			case vtu_encoding::appended:
+				out.write(" format=\"appended\" offset=\"" + std::to_string(appended_offset) + "\"/>\n");
+				appended_offset += sizeof(uint64_t) + a.num_values * a.value_size;
+				break;
+			}
+		}
+	};
+
+
+
+
+	// parallel VTU : one .vtu file per piece plus a .pvtu index
+	class pvtu_mesh_io : public mesh_io_base {
+	public:
+		// pieces written by save, 0 = one per thread
+		void set_num_pieces(size_t num_pieces) { num_pieces_ = num_pieces; }
+		// points of different pieces closer than tolerance are merged on load, < 0 = off
+		void set_weld_tolerance(double tolerance) { weld_tolerance_ = tolerance; }
+
+		load_t load(std::string fileName) override {
+
+			load_t load_func;
+
+			load_func = [fileName, weld_tolerance = weld_tolerance_](mesh& msh) {
+
+				std::vector<std::string> sources = read_sources(fileName);
+				if (sources.empty()) {
+					std::cerr << "Error: no pieces listed in " << fileName << std::endl;
+					return;
+				}
+
+				// pieces are read concurrently, then numbered globally in piece order;
+				// a missing piece leaves msh as it was rather than a partial domain
+				std::vector<mesh> pieces(sources.size());
+				std::vector<char> loaded(sources.size(), 0);
+				std::atomic<size_t> next{ 0 };
+				parallel_for(0, std::min(num_threads(), sources.size()), [&](size_t t0, size_t t1) {
+					for (size_t t = t0; t < t1; ++t) {
+						for (size_t i = next++; i < sources.size(); i = next++) {
+							loaded[i] = vtu_mesh_io::read_file(sources[i], {}, pieces[i]);
+						}
+					}
+					}, 1);
+				size_t num_failed = std::count(loaded.begin(), loaded.end(), 0);
+				if (num_failed > 0) {
+					std::cerr << "Error: " << num_failed << " of " << sources.size() << " pieces of " << fileName
+						<< " could not be read" << std::endl;
+					return;
+				}
+
+				mesh merged = merge_meshes(pieces);
+				pieces.clear();
+
+				if (weld_tolerance >= 0.0) {
+					auto old2new = weld_vertices(merged.pos, weld_tolerance);
+					c2v_t c2v = merged.c2v();
+					for (auto* conn : { &merged.f2v, &c2v }) {
+						auto& indices = conn->indices();
+						parallel_for(0, indices.size(), [&](size_t i0, size_t i1) {
+							for (size_t i = i0; i < i1; ++i) indices[i] = old2new[indices[i]];
+							});
+					}
+					merged.set_c2v(std::move(c2v));
+				}
+
+				if (msh.pos.empty() && msh.f2v.empty() && msh.c2v().empty()) {
+					msh = std::move(merged);
+				}
+				else {
+					std::vector<mesh> both;
+					both.push_back(std::move(msh));
+					both.push_back(std::move(merged));
+					msh = merge_meshes(both);
+				}
+
+				std::cout << "Complete Load PVTU mesh from " << fileName << " (" << sources.size() << " pieces)" << std::endl;
+
+			};
+
+			return load_func;
+		}
+
+		save_t save(std::string fileName) override {
+
+			save_t save_func;
+
+			save_func = [fileName, format = format_, num_pieces = num_pieces_](mesh& msh) {
+
+				std::filesystem::path index_path(fileName);
+				std::string stem = index_path.stem().string();
+
+				// pieces cut by coordinate bisection of the cells, or the whole
+				// surface for cell-less meshes
+				size_t num_cells = msh.num_cells();
+				size_t n = num_cells == 0 ? 1 : std::min(num_cells, num_pieces == 0 ? num_threads() : num_pieces);
+				csr_array<size_t> part_cells;
+				if (num_cells > 0) {
+					auto part = partition_rcb(cell_point_averages(msh), n);
+					part_cells = invert_rows<size_t>(num_cells, n, [&](size_t c) {
+						return std::array<size_t, 1>{ static_cast<size_t>(part[c]) };
+						});
+				}
+
+				std::vector<std::string> names(n);
+				std::vector<char> written(n, 0);
+				parallel_for(0, n, [&](size_t p0, size_t p1) {
+					for (size_t p = p0; p < p1; ++p) {
+						names[p] = stem + "_" + std::to_string(p) + ".vtu";
+						std::filesystem::path piece_path = index_path.parent_path() / names[p];
+						if (num_cells == 0) {
+							written[p] = vtu_mesh_io::write_file(piece_path.string(), format, msh);
+						}
+						else {
+							auto cells = part_cells[p];
+							mesh piece = extract_cells(msh, std::span<const size_t>(cells.data(), cells.size()));
+							written[p] = vtu_mesh_io::write_file(piece_path.string(), format, piece);
+						}
+					}
+					}, 1);
+				// pieces that failed are left out of the index
+				size_t num_failed = static_cast<size_t>(std::count(written.begin(), written.end(), 0));
+				if (num_failed > 0) {
+					std::cerr << "Error: " << num_failed << " of " << n << " pieces of " << fileName << " could not be written" << std::endl;
+				}
+
+				buffered_writer out(index_path);
+				if (!out.is_open()) {
+					std::cerr << "Unable to write file for writing." << std::endl;
+					return;
+				}
+				out.write("<?xml version=\"1.0\"?>\n");
+				out.write(" <VTKFile type=\"PUnstructuredGrid\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt64\">\n");
+				out.write("  <PUnstructuredGrid GhostLevel=\"0\">\n");
+				out.write("   <PPointData>\n");
+				out.write("   </PPointData>\n");
+				out.write("   <PCellData>\n");
+				out.write("   </PCellData>\n");
+				out.write("   <PPoints>\n");
+				out.write("    <PDataArray type=\"Float64\" Name=\"NodeCoordinates\" NumberOfComponents=\"3\"/>\n");
+				out.write("   </PPoints>\n");
+				for (size_t p = 0; p < n; ++p) {
+					if (written[p]) out.write("   <Piece Source=\"" + names[p] + "\"/>\n");
+				}
+				out.write("  </PUnstructuredGrid>\n");
+				out.write(" </VTKFile>\n");
+				out.close();
+
+				std::cout << "Complete Save PVTU mesh to " << fileName << " (" << n - num_failed << " pieces)" << std::endl;
+
+			};
+
+			return save_func;
+		}
+
+	private:
+		// piece file paths, relative sources resolved against the index location
+		static std::vector<std::string> read_sources(const std::string& fileName) {
+			std::vector<std::string> sources;
+			mapped_file file(fileName);
+			if (!file.is_open()) {
+				std::cerr << "Error: Cannot open file " << fileName << '\n';
+				return sources;
+			}
+			std::filesystem::path dir = std::filesystem::path(fileName).parent_path();
+			xml_scanner xml(file.data(), file.data() + file.size());
+			xml_tag tag;
+			while (xml.next(tag)) {
+				if (tag.name == "Piece" && !tag.closing) {
+					std::filesystem::path source(std::string(tag.attribute("Source")));
+					if (source.empty()) continue;
+					sources.push_back((source.is_absolute() ? source : dir / source).string());
+				}
+			}
+			return sources;
+		}
+
+		size_t num_pieces_ = 0;
+		double weld_tolerance_ = -1.0;
+	};
+
+
+
+
+
+
+
+	class mesh_io_factory {
+	public:
+		mesh_io_factory() {
+			creators["stl"] = []() { return std::make_unique<stl_mesh_io>(); };
+			creators["obj"] = []() { return std::make_unique<obj_mesh_io>(); };
+			creators["vtu"] = []() { return std::make_unique<vtu_mesh_io>(); };
+			creators["pvtu"] = []() { return std::make_unique<pvtu_mesh_io>(); };
+			creators[""] = []() { return std::make_unique<openfoam_mesh_io>(); };
+		}
+
+		std::unique_ptr<mesh_io_base> create(const std::string& format) {
+			auto it = creators.find(format);
+			if (it != creators.end()) {
+				return it->second();
+			}
+			else {
+				return nullptr;
+			}
+		}
+
+	private:
+		std::map<std::string, std::function<std::unique_ptr<mesh_io_base>()>> creators;
+	};
+
+
+
+
+
+	class mesh_io {
+	public:
+		std::optional<load_t> load(const std::string& filename) {
+			std::string format = get_file_extension(filename);
+			to_lower(format);
+			mesh_io_ = std::make_unique<mesh_io_factory>()->create(format);
+			if (!mesh_io_) {
+				std::cerr << "Unknown format: " << format << std::endl;
+				return std::nullopt;
+			}
+			return mesh_io_->load(filename);
+		}
+
+		std::optional<save_t> save(const std::string& filename, data_format data = data_format::native) {
+			std::string format = get_file_extension(filename);
+			to_lower(format);
+			mesh_io_ = std::make_unique<mesh_io_factory>()->create(format);
+			if (!mesh_io_) {
+				std::cerr << "Unknown format: " << format << std::endl;
+				return std::nullopt;
+			}
+			mesh_io_->set_format(data);
+			return mesh_io_->save(filename);
+		}
+
+	private:
+		std::unique_ptr<mesh_io_base> mesh_io_;
+	};
+
+
+
+
+
+	// cells of every face -> faces of every cell
+	c2f_t make_c2f_from_f2c(const f2c_t& f2c) {
+
+		// largest cell id, per block then combined
+		std::atomic<size_t> max_cell{ 0 };
+		const auto& cells = f2c.indices();
+		parallel_for(0, cells.size(), [&](size_t i0, size_t i1) {
+			size_t m = 0;
+			for (size_t i = i0; i < i1; ++i) m = std::max<size_t>(m, cells[i]);
+			size_t cur = max_cell.load();
+			while (cur < m && !max_cell.compare_exchange_weak(cur, m)) {}
+			});
+		size_t num_cell = cells.empty() ? 0 : max_cell.load() + 1;
+
+		// count faces per cell, prefix sum, scatter face ids (faces stay in increasing order per cell)
+		return invert_csr(f2c, num_cell);
+
+	}
+
+
+	// rows of sorted unique values; visit(r, add) calls add(v) for every value
+	// of row r, repeats allowed. Every block collects its rows into its own
+	// buffer, the blocks are then copied into one flat array behind each other.
+	template<typename Visit>
+	csr_array<index_t> collect_sorted_sets(size_t num_rows, Visit visit) {
+
+		constexpr size_t grain = 4096;
+		size_t num_blocks = std::max<size_t>(1, std::min(num_threads(), (num_rows + grain - 1) / grain));
+		size_t block = (num_rows + num_blocks - 1) / num_blocks;
+
+		std::vector<std::vector<index_t>> block_values(num_blocks);
+		std::vector<size_t> offsets(num_rows + 1, 0);
+		parallel_for(0, num_blocks, [&](size_t b0, size_t b1) {
+			for (size_t b = b0; b < b1; ++b) {
+				auto& out = block_values[b];
+				for (size_t r = std::min(num_rows, b * block); r < std::min(num_rows, (b + 1) * block); ++r) {
+					// sorted insertion into the row's small set, skipping repeats
+					size_t first = out.size();
+					visit(r, [&](index_t v) {
+						size_t at = out.size();
+						while (at > first && out[at - 1] > v) --at;
+						if (at > first && out[at - 1] == v) return;
+						out.insert(out.begin() + at, v);
+						});
+					offsets[r + 1] = out.size() - first;
+				}
+			}
+			}, 1);
+		for (size_t r = 0; r < num_rows; ++r) offsets[r + 1] += offsets[r];
+
+		std::vector<index_t> indices(offsets[num_rows]);
+		parallel_for(0, num_blocks, [&](size_t b0, size_t b1) {
+			for (size_t b = b0; b < b1; ++b) {
+				size_t r0 = std::min(num_rows, b * block);
+				std::copy(block_values[b].begin(), block_values[b].end(), indices.begin() + offsets[r0]);
+			}
+			}, 1);
+		csr_array<index_t> result;
+		result.offsets() = std::move(offsets);
+		result.indices() = std::move(indices);
+		return result;
+	}
+
+
+	// rows[order[0]], rows[order[1]], ... as a new array
+	template<typename T>
+	csr_array<T> gather_rows(const csr_array<T>& rows, const std::vector<size_t>& order) {
+		csr_array<T> result;
+		std::vector<size_t> counts(order.size());
+		for (size_t i = 0; i < order.size(); ++i) counts[i] = rows[order[i]].size();
+		result.assign_counts(counts);
+		parallel_for(0, order.size(), [&](size_t i0, size_t i1) {
+			for (size_t i = i0; i < i1; ++i) {
+				auto row = rows[order[i]];
+				std::copy(row.begin(), row.end(), result[i].begin());
+			}
+			});
+		return result;
+	}
+
+
+	// sorted unique points of every cell
+	c2v_t make_c2v_from_c2f_f2v(const c2f_t& c2f, const f2v_t& f2v) {
+		return collect_sorted_sets(c2f.size(), [&](size_t c, auto add) {
+			for (auto f : c2f[c]) {
+				for (auto v : f2v[f]) add(v);
+			}
+			});
+	}
+
+
+	// faces around every point, in increasing order
+	v2f_t make_v2f_from_f2v(const f2v_t& f2v, size_t num_points) {
+		return invert_csr(f2v, num_points);
+	}
+
+	// cells around every point, in increasing order
+	v2c_t make_v2c_from_c2v(const c2v_t& c2v, size_t num_points) {
+		return invert_csr(c2v, num_points);
+	}
+
+	// sorted points sharing a face edge with every point
+	v2v_t make_v2v_from_v2f_f2v(const v2f_t& v2f, const f2v_t& f2v) {
+		return collect_sorted_sets(v2f.size(), [&](size_t v, auto add) {
+			for (auto f : v2f[v]) {
+				auto points = f2v[f];
+				size_t n = points.size();
+				for (size_t i = 0; i < n; ++i) {
+					if (points[i] != v) continue;
+					add(points[(i + 1) % n]);
+					add(points[(i + n - 1) % n]);
+				}
+			}
+			});
+	}
+
+
+	// edges are keyed by their two points packed into 64 bits, found with a
+	// lock-free open addressing table and numbered in order of first appearance
+	edge_table make_edge_table(const f2v_t& f2v) {
+
+		constexpr std::uint64_t empty = std::numeric_limits<std::uint64_t>::max();
+		edge_table edges;
+		size_t num_faces = f2v.size();
+		size_t num_half = f2v.num_entries();
+		const auto& offsets = f2v.offsets();
+		if (num_half == 0) return edges;
+
+		const auto& points = f2v.indices();
+		std::atomic<bool> too_large{ false };
+		parallel_for(0, num_half, [&](size_t i0, size_t i1) {
+			for (size_t i = i0; i < i1; ++i) {
+				if (points[i] >= 0xFFFFFFFFull) too_large = true;
+			}
+			});
+		if (too_large) {
+			std::cerr << "Edge table : point indices do not fit in 32 bits" << std::endl;
+			return edges;
+		}
+
+		auto key_of = [&](size_t f, size_t i) {
+			auto row = f2v[f];
+			std::uint64_t a = row[i];
+			std::uint64_t b = row[(i + 1) % row.size()];
+			if (a > b) std::swap(a, b);
+			return (a << 32) | b;
+			};
+		auto hash_of = [](std::uint64_t k) {
+			k ^= k >> 33;
+			k *= 0xFF51AFD7ED558CCDull;
+			k ^= k >> 33;
+			k *= 0xC4CEB9FE1A85EC53ull;
+			k ^= k >> 33;
+			return k;
+			};
+
+		// slot of every half edge (face f, point i to i + 1)
+		size_t num_slots = 1;
+		while (num_slots < 2 * num_half) num_slots <<= 1;
+		std::vector<std::uint64_t> table(num_slots, empty);
+		std::vector<size_t> slot_of(num_half);
+		parallel_for(0, num_faces, [&](size_t f0, size_t f1) {
+			for (size_t f = f0; f < f1; ++f) {
+				for (size_t i = 0; i < offsets[f + 1] - offsets[f]; ++i) {
+					std::uint64_t k = key_of(f, i);
+					size_t s = hash_of(k) & (num_slots - 1);
+					for (;; s = (s + 1) & (num_slots - 1)) {
+						std::atomic_ref<std::uint64_t> slot(table[s]);
+						std::uint64_t cur = slot.load(std::memory_order_acquire);
+						if (cur == empty && slot.compare_exchange_strong(cur, k, std::memory_order_acq_rel)) break;
+						if (cur == k) break;
+					}
+					slot_of[offsets[f] + i] = s;
+				}
+			}
+			});
+
+		// first half edge of every slot
+		parallel_for(0, num_slots, [&](size_t s0, size_t s1) {
+			std::fill(table.begin() + s0, table.begin() + s1, empty);
+			});
+		parallel_for(0, num_half, [&](size_t h0, size_t h1) {
+			for (size_t h = h0; h < h1; ++h) {
+				std::atomic_ref<std::uint64_t> slot(table[slot_of[h]]);
+				std::uint64_t cur = slot.load(std::memory_order_relaxed);
+				while (h < cur && !slot.compare_exchange_weak(cur, h, std::memory_order_relaxed)) {}
+			}
+			});
+
+		// number the first half edges block by block, in face order
+		constexpr size_t grain = 4096;
+		size_t num_blocks = std::max<size_t>(1, std::min(num_threads(), (num_faces + grain - 1) / grain));
+		size_t block = (num_faces + num_blocks - 1) / num_blocks;
+		std::vector<std::uint8_t> first(num_half);
+		std::vector<size_t> block_edges(num_blocks + 1, 0);
+		parallel_for(0, num_blocks, [&](size_t b0, size_t b1) {
+			for (size_t b = b0; b < b1; ++b) {
+				size_t h0 = offsets[std::min(num_faces, b * block)];
+				size_t h1 = offsets[std::min(num_faces, (b + 1) * block)];
+				for (size_t h = h0; h < h1; ++h) {
+					first[h] = table[slot_of[h]] == h;
+					block_edges[b + 1] += first[h];
+				}
+			}
+			}, 1);
+		for (size_t b = 0; b < num_blocks; ++b) block_edges[b + 1] += block_edges[b];
+		size_t num_edges = block_edges[num_blocks];
+
+		edges.e2v.resize(num_edges);
+		parallel_for(0, num_blocks, [&](size_t b0, size_t b1) {
+			for (size_t b = b0; b < b1; ++b) {
+				size_t e = block_edges[b];
+				for (size_t f = std::min(num_faces, b * block); f < std::min(num_faces, (b + 1) * block); ++f) {
+					for (size_t h = offsets[f]; h < offsets[f + 1]; ++h) {
+						if (!first[h]) continue;
+						std::uint64_t k = key_of(f, h - offsets[f]);
+						edges.e2v[e] = { static_cast<index_t>(k >> 32), static_cast<index_t>(k & 0xFFFFFFFFull) };
+						table[slot_of[h]] = e++;
+					}
+				}
+			}
+			}, 1);
+		std::vector<index_t> edge_of(num_half);
+		parallel_for(0, num_half, [&](size_t h0, size_t h1) {
+			for (size_t h = h0; h < h1; ++h) edge_of[h] = static_cast<index_t>(table[slot_of[h]]);
+			});
+
+		edges.f2e.offsets() = offsets;
+		edges.f2e.indices() = std::move(edge_of);
+		const auto& f2e = edges.f2e;
+		edges.e2f = invert_rows<index_t>(num_faces, num_edges, [&](size_t f) { return f2e[f]; });
+		const auto& e2f = edges.e2f;
+		edges.f2f = collect_sorted_sets(num_faces, [&](size_t f, auto add) {
+			for (auto e : f2e[f]) {
+				for (auto g : e2f[e]) {
+					if (g != f) add(g);
+				}
+			}
+			});
+		edges.flags.resize(num_edges);
+		parallel_for(0, num_edges, [&](size_t e0, size_t e1) {
+			for (size_t e = e0; e < e1; ++e) {
+				size_t n = e2f[e].size();
+				edges.flags[e] = n == 1 ? edge_table::boundary : n > 2 ? edge_table::non_manifold : 0;
+			}
+			});
+		return edges;
+	}
+
+
+	// patch index per face from the patch face ranges
+	f2p_t f2p_from_patches(const std::vector<patch>& patches, size_t num_faces) {
+		f2p_t f2p(num_faces, -1);
+		for (size_t p = 0; p < patches.size(); ++p) {
+			size_t f0 = std::min(patches[p].start_face, num_faces);
+			size_t f1 = std::min(patches[p].end_face(), num_faces);
+			parallel_for(f0, f1, [&](size_t i0, size_t i1) {
+				std::fill(f2p.begin() + i0, f2p.begin() + i1, static_cast<int32_t>(p));
+				});
+		}
+		return f2p;
+	}
+
+	void make_f2p_from_patches(mesh& msh) {
+		msh.f2p = f2p_from_patches(msh.patches, msh.f2v.size());
+	}
+
+	// the faces of a new -> old order sorted by patch : row 0 holds the faces in
+	// no patch, row p + 1 those of patch p, each in the given order
+	csr_array<std::size_t> faces_by_patch(const f2p_t& f2p, std::size_t num_patches,
+		const std::vector<std::size_t>& order) {
+		auto rows = invert_rows<size_t>(order.size(), num_patches + 1, [&](size_t i) {
+			int32_t p = f2p[order[i]];
+			return std::array<size_t, 1>{ p < 0 || static_cast<size_t>(p) >= num_patches ? 0 : static_cast<size_t>(p) + 1 };
+			});
+		auto& faces = rows.indices();
+		parallel_for(0, faces.size(), [&](size_t i0, size_t i1) {
+			for (size_t i = i0; i < i1; ++i) faces[i] = order[faces[i]];
+			});
+		return rows;
+	}
+
+	// patch face ranges once the faces are in the order of faces_by_patch
+	void set_patch_ranges(std::vector<patch>& patches, const csr_array<std::size_t>& by_patch) {
+		for (size_t p = 0; p < patches.size(); ++p) {
+			patches[p].start_face = by_patch.offsets()[p + 1];
+			patches[p].num_faces = by_patch[p + 1].size();
+		}
+	}
+
+
+
+	//===================================================
+	// concatenates meshes; point, face and cell numbers of each piece are
+	// shifted by the totals of the pieces before it
+	mesh merge_meshes(const std::vector<mesh>& pieces) {
+
+		mesh merged;
+		size_t n = pieces.size();
+		std::vector<size_t> pos0(n + 1, 0), face0(n + 1, 0), cell0(n + 1, 0);
+		for (size_t p = 0; p < n; ++p) {
+			pos0[p + 1] = pos0[p] + pieces[p].pos.size();
+			face0[p + 1] = face0[p] + pieces[p].f2v.size();
+			cell0[p + 1] = cell0[p] + std::max(pieces[p].c2f().size(), pieces[p].c2v().size());
+		}
+		if (!fits_index(pos0[n], "points") || !fits_index(face0[n], "faces") ||
+			!fits_index(cell0[n], "cells")) return merged;
+
+		merged.pos.resize(pos0[n]);
+		parallel_for(0, n, [&](size_t p0, size_t p1) {
+			for (size_t p = p0; p < p1; ++p) {
+				merged.pos.copy_from(pieces[p].pos, pos0[p]);
+			}
+			}, 1);
+
+		// rows of every piece copied behind each other, values shifted by base[p]
+		auto concat = [&](auto rows_of, const std::vector<size_t>& base, auto& out) {
+			std::vector<size_t> row0(n + 1, 0), ent0(n + 1, 0);
+			for (size_t p = 0; p < n; ++p) {
+				row0[p + 1] = row0[p] + rows_of(pieces[p]).size();
+				ent0[p + 1] = ent0[p] + rows_of(pieces[p]).num_entries();
+			}
+			out.offsets().resize(row0[n] + 1);
+			out.indices().resize(ent0[n]);
+			parallel_for(0, n, [&](size_t p0, size_t p1) {
+				for (size_t p = p0; p < p1; ++p) {
+					auto& src = rows_of(pieces[p]);
+					for (size_t r = 0; r < src.size(); ++r) {
+						out.offsets()[row0[p] + r + 1] = ent0[p] + src.offsets()[r + 1];
+					}
+					for (size_t e = 0; e < src.num_entries(); ++e) {
+						out.indices()[ent0[p] + e] = src.indices()[e] + base[p];
+					}
+				}
+				}, 1);
+			};
+		c2f_t c2f;
+		c2v_t c2v;
+		concat([](const mesh& m) -> const f2v_t& { return m.f2v; }, pos0, merged.f2v);
+		concat([](const mesh& m) -> const f2c_t& { return m.f2c; }, cell0, merged.f2c);
+		concat([](const mesh& m) -> const c2f_t& { return m.c2f(); }, face0, c2f);
+		concat([](const mesh& m) -> const c2v_t& { return m.c2v(); }, pos0, c2v);
+		merged.set_c2f(std::move(c2f));
+		merged.set_c2v(std::move(c2v));
+
+		return merged;
+	}
+
+
+	//===================================================
+	// sub mesh made of the given cells, with local point / face / cell numbers;
+	// faces shared with cells outside the list keep only their inside cell.
+	// Patches and f2p are carried over, the faces of each patch moved together;
+	// face_map receives the index in msh of every sub mesh face.
+	mesh extract_cells(const mesh& msh, std::span<const std::size_t> cells,
+		std::vector<std::size_t>* face_map) {
+
+		constexpr size_t none = std::numeric_limits<size_t>::max();
+		mesh sub;
+		const auto& c2f = msh.c2f();
+		const auto& c2v = msh.c2v();
+
+		std::vector<size_t> cell_map(msh.num_cells(), none);
+		for (size_t i = 0; i < cells.size(); ++i) cell_map[cells[i]] = i;
+
+		// faces and points in global order
+		std::vector<size_t> faces;
+		for (auto c : cells) {
+			for (auto f : c2f[c]) faces.push_back(f);
+		}
+		std::sort(faces.begin(), faces.end());
+		faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+
+		std::vector<size_t> points;
+		for (auto f : faces) {
+			for (auto v : msh.f2v[f]) points.push_back(v);
+		}
+		for (auto c : cells) {
+			if (c < c2v.size()) {
+				for (auto v : c2v[c]) points.push_back(v);
+			}
+		}
+		std::sort(points.begin(), points.end());
+		points.erase(std::unique(points.begin(), points.end()), points.end());
+
+		auto local_point = [&points](size_t v) {
+			return static_cast<size_t>(std::lower_bound(points.begin(), points.end(), v) - points.begin());
+			};
+		auto local_face = [&faces](size_t f) {
+			return static_cast<size_t>(std::lower_bound(faces.begin(), faces.end(), f) - faces.begin());
+			};
+
+		sub.pos = msh.pos.gather(points);
+
+		sub.f2v.reserve(faces.size(), 0);
+		sub.f2c.reserve(faces.size(), faces.size());
+		for (auto f : faces) {
+			sub.f2v.emplace_back();
+			for (auto v : msh.f2v[f]) sub.f2v.append_to_back(local_point(v));
+			sub.f2c.emplace_back();
+			if (f < msh.f2c.size()) {
+				for (auto c : msh.f2c[f]) {
+					if (cell_map[c] != none) sub.f2c.append_to_back(cell_map[c]);
+				}
+			}
+		}
+
+		c2f_t sub_c2f;
+		sub_c2f.reserve(cells.size(), 0);
+		for (auto c : cells) {
+			sub_c2f.emplace_back();
+			for (auto f : c2f[c]) sub_c2f.append_to_back(local_face(f));
+		}
+		sub.set_c2f(std::move(sub_c2f));
+		if (!c2v.empty()) {
+			c2v_t sub_c2v;
+			sub_c2v.reserve(cells.size(), 0);
+			for (auto c : cells) {
+				sub_c2v.emplace_back();
+				for (auto v : c2v[c]) sub_c2v.append_to_back(local_point(v));
+			}
+			sub.set_c2v(std::move(sub_c2v));
+		}
+
+		sub.patches = msh.patches;
+		if (msh.f2p.size() == msh.f2v.size() || !msh.patches.empty()) {
+			f2p_t ranges;
+			const f2p_t* f2p = &msh.f2p;
+			if (msh.f2p.size() != msh.f2v.size()) {
+				ranges = f2p_from_patches(msh.patches, msh.f2v.size());
+				f2p = &ranges;
+			}
+			sub.f2p.resize(faces.size());
+			for (size_t i = 0; i < faces.size(); ++i) sub.f2p[i] = (*f2p)[faces[i]];
+
+			// the faces of a patch need not be contiguous among the local ones
+			auto order = group_patch_faces(sub);
+			std::vector<size_t> grouped(faces.size());
+			for (size_t i = 0; i < faces.size(); ++i) grouped[i] = faces[order[i]];
+			faces = std::move(grouped);
+		}
+		if (face_map) *face_map = std::move(faces);
+
+		return sub;
+	}
+
+
+
+	class mesh_treatment {
+	public:
+
+
+
+
+
+	};
+
+
+
+
+
+	//===================================================
+	// ҵ    Ȯϴ Լ
+	template <typename Container>
+	bool approximately_equal(const Container& a, const Container& b,
+		const typename Container::value_type& epsilon =
+		2.0 * std::numeric_limits<typename Container::value_type>::epsilon()) {
+		auto it_a = a.begin();
+		auto it_b = b.begin();
+
+		while (it_a != a.end() && it_b != b.end()) {
+			if (std::abs(*it_a - *it_b) > epsilon) {
+				return false;
+			}
+			++it_a;
+			++it_b;
+		}
+
+		return true;
+	}
+
+
+	//===================================================
+	// ־ ̳  "" "ߺ " ,
+	// ŵ     ܼ ä , 
+	//   ο ε(ߺ̸ ߺ   
+	//  ù°  ε)  ȯմϴ.
+	template <typename Container, typename Func =
+		std::function<typename Container::value_type& (typename Container::value_type&)>>
+		std::vector<std::size_t> sort_and_unique_indices(
+			Container& values,
+			Func func = [](auto& p) ->
+			auto& {
+				return p;
+			}) {
+		//template <typename Container, typename Func>
+		//std::vector<unsigned> sortAndUniqueIndices(Container & values, Func func) {
+			//std::function<T> func = [](typename Container::value_type& p) { return p; }) {
+
+		std::vector<std::size_t> indices(values.size());
+		std::vector<std::size_t*> indicesPtr(values.size());
+		for (std::size_t i = 0; i < values.size(); ++i) {
+			indices[i] = i;
+			indicesPtr[i] = &indices[i];
+		}
+		//std::iota(std::begin(indices), std::end(indices), 0);
+
+		// ־ Լ ̿Ͽ  Ͽ ε մϴ.
+		std::sort(indicesPtr.begin(), indicesPtr.end(),
+			[&values, func](std::size_t* i1, std::size_t* i2) {
+				return std::lexicographical_compare(
+					func(values[*i1]).begin(), func(values[*i1]).end(),
+					func(values[*i2]).begin(), func(values[*i2]).end());
+			});
+
+		// ĵ ε ٽ οմϴ.
+		for (std::size_t i = 0; i < values.size(); ++i) {
+			*indicesPtr[i] = static_cast<std::size_t>(i);
+		}
+
+		// ־ Լ ̿Ͽ  Ͽ Ҹ մϴ.
+		std::sort(values.begin(), values.end(), [func](auto& a, auto& b) {
+			return std::lexicographical_compare(
+				func(a).begin(), func(a).end(),
+				func(b).begin(), func(b).end());
+			});
+
+
+		auto approximately_equal_with_epsilon = [](auto a, auto b) {
+			return approximately_equal(a, b, 1.e-12);
+			};
+
+		// ߺ ҿ  ο ε οմϴ.
+		for (std::size_t i = 1, j = 0; i < values.size(); ++i) {
+			if (approximately_equal_with_epsilon(func(values[i - 1]), func(values[i]))) {
+				//indicesPtr[i]->second = true;
+				*indicesPtr[i] = static_cast<std::size_t>(j);
+			}
+			else {
+				*indicesPtr[i] = static_cast<std::size_t>(++j);
+			}
+		}
+
+		// ߺ ҵ մϴ.
+		auto new_end = std::unique(values.begin(), values.end(),
+			[approximately_equal_with_epsilon, func](auto& a, auto& b) {
+				return approximately_equal_with_epsilon(func(a), func(b));
+			});
+
+		values.erase(new_end, values.end());
+
+		return indices;
+
+	}
+
+
+	////===================================================
 	//// ͸ ÷ϰ ִ Լ
 	//template <typename E, typename X>
 	//constexpr void flatten(const std::vector<E>& v, std::vector<X>& out) {
@@ -1166,160 +4324,1503 @@ namespace semo {
 			[func](auto& elem1, auto& elem2) {
 				return func(elem1) < func(elem2); // Added return statement
 			});
-		return std::make_pair(
-			func(*(minmax.first)),
-			func(*(minmax.second))
-		);
+		return std::make_pair(
+			func(*(minmax.first)),
+			func(*(minmax.second))
+		);
+	}
+
+	template<typename Out, typename T>
+	std::pair< Out, Out> minmax_elements(T& container) {
+		return minmax_elements<Out>(container,
+			[](const auto& elem) { return elem; });
+	}
+
+
+
+
+	//===================================================
+	// myVector ҵ indices  ű
+	template<typename T>
+	void rearrange_elements_to_indices_mutable(std::vector<T>& myVector,
+		std::vector<std::size_t>& indices) {
+		std::size_t size = myVector.size();
+
+		//  ε   ġ Ҹ ǥ ġ swapմϴ.
+		for (std::size_t i = 0; i < size; ++i) {
+			while (indices[i] != i) {
+				std::swap(myVector[i], myVector[indices[i]]);
+				std::swap(indices[i], indices[indices[i]]);
+			}
+		}
+	}
+
+	// myVector ҵ indices  ű
+	template<typename T>
+	void rearrange_elements_to_indices(std::vector<T>& myVector,
+		const std::vector<std::size_t>& indices) {
+		std::vector<std::size_t> copy_indices(indices);
+		rearrange_elements_to_indices_mutable(myVector, copy_indices);
+	}
+
+	// indices ġ myVector Ҹ ű
+	template<typename T>
+	void rearrange_elements_from_indices(std::vector<T>& myVector,
+		const std::vector<std::size_t>& indices) {
+		std::size_t size = myVector.size();
+		std::vector<std::size_t> copy_indices(size);
+		for (std::size_t i = 0; i < size; ++i) {
+			copy_indices[indices[i]] = i;
+		}
+		rearrange_elements_to_indices_mutable(myVector, copy_indices);
+	}
+
+
+
+	//===================================================
+	// Լ α׷
+	template <typename F>
+	auto compose(F&& f)
+	{
+		return [a = std::move(f)](auto&&... args) {
+			return a(std::move(args)...);
+			};
+	}
+
+	template <typename F1, typename F2, typename... Fs>
+	auto compose(F1&& f1, F2&& f2, Fs&&... fs)
+	{
+		return compose(
+			[first = std::move(f1), second = std::move(f2)]
+			(auto&&... args) {
+				return second(first(std::move(args)...));
+			},
+			std::move(fs)...
+		);
+	}
+
+
+	template <typename... Funcs>
+	decltype(auto) combine(Funcs... fs) {
+		return [fs...](auto... inps) {
+			(fs(inps...), ...);
+			};
+	}
+
+
+	//===================================================
+	// ִ Ȯ
+	template <typename Container, typename Value>
+	bool is_there(Container& inp, Value value) {
+		return std::find(inp.begin(), inp.end(), value) != inp.end();
+	}
+
+	//===================================================
+	// input  ε  ִ ͸ , ε κ Ѳ ȿ 
+	template<typename T, typename Container2>
+	void erase_elements_by_indices(std::vector<T>& myVector,
+		const Container2& indices) {
+		std::size_t size = myVector.size();
+		std::vector<bool> to_remove(size, false);
+		for (auto i : indices) {
+			to_remove[i] = true;
+		}
+		std::size_t i = 0;
+		myVector.erase(
+			std::remove_if(myVector.begin(), myVector.end(),
+				[&to_remove, i](const auto&) mutable {
+					return to_remove[i++];
+				}),
+			myVector.end());
+	}
+
+
+
+
+	//===================================================
+	// merges points closer than tolerance using a uniform grid hash;
+	// pos is compacted in first occurrence order, the returned vector maps
+	// old -> new point index. Points chained within tolerance are merged.
+	std::vector<std::size_t> weld_vertices(pos_t& pos, double tolerance) {
+
+		std::size_t n = pos.size();
+		std::vector<std::size_t> old2new(n);
+		if (n == 0) return old2new;
+
+		// grid cell no smaller than the tolerance, so matches are in the 27 neighbour cells
+		std::array<double, 3> lo = pos[0], hi = pos[0];
+		for (const auto& p : pos) {
+			for (int k = 0; k < 3; ++k) {
+				lo[k] = std::min(lo[k], p[k]);
+				hi[k] = std::max(hi[k], p[k]);
+			}
+		}
+		double extent = std::max({ hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] });
+		double cell = std::max(tolerance, extent * std::ldexp(1.0, -40));
+		if (!(cell > 0.0)) cell = 1.0;
+
+		using cell_t = std::array<std::int64_t, 3>;
+		std::vector<cell_t> cells(n);
+		std::size_t num_buckets = 1;
+		while (num_buckets < n) num_buckets <<= 1;
+		auto bucket_of = [num_buckets](const cell_t& c) {
+			std::uint64_t h = static_cast<std::uint64_t>(c[0]) * 0x9E3779B97F4A7C15ull;
+			h ^= static_cast<std::uint64_t>(c[1]) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+			h ^= static_cast<std::uint64_t>(c[2]) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+			h ^= h >> 29;
+			return static_cast<std::size_t>(h & (num_buckets - 1));
+			};
+		std::vector<std::size_t> bucket(n);
+		parallel_for(0, n, [&](std::size_t i0, std::size_t i1) {
+			for (std::size_t i = i0; i < i1; ++i) {
+				for (int k = 0; k < 3; ++k) {
+					cells[i][k] = static_cast<std::int64_t>(std::floor((pos[i][k] - lo[k]) / cell));
+				}
+				bucket[i] = bucket_of(cells[i]);
+			}
+			});
+		auto buckets = invert_rows<std::size_t>(n, num_buckets,
+			[&bucket](std::size_t i) { return std::span<const std::size_t>(&bucket[i], 1); });
+
+		// smallest point index within tolerance (itself at worst)
+		double tol2 = tolerance * tolerance;
+		std::vector<std::size_t> rep(n);
+		parallel_for(0, n, [&](std::size_t i0, std::size_t i1) {
+			for (std::size_t i = i0; i < i1; ++i) {
+				std::size_t best = i;
+				for (std::int64_t dx = -1; dx <= 1; ++dx) {
+					for (std::int64_t dy = -1; dy <= 1; ++dy) {
+						for (std::int64_t dz = -1; dz <= 1; ++dz) {
+							cell_t c{ cells[i][0] + dx, cells[i][1] + dy, cells[i][2] + dz };
+							for (auto j : buckets[bucket_of(c)]) {
+								if (j >= best) break;
+								double d0 = pos[i][0] - pos[j][0];
+								double d1 = pos[i][1] - pos[j][1];
+								double d2 = pos[i][2] - pos[j][2];
+								if (d0 * d0 + d1 * d1 + d2 * d2 <= tol2) {
+									best = j;
+									break;
+								}
+							}
+						}
+					}
+				}
+				rep[i] = best;
+			}
+			});
+
+		// rep[i] <= i, so one forward sweep resolves chains and numbers the survivors
+		std::vector<std::size_t> survivors;
+		for (std::size_t i = 0; i < n; ++i) {
+			if (rep[i] == i) {
+				old2new[i] = survivors.size();
+				survivors.push_back(i);
+			}
+			else {
+				old2new[i] = old2new[rep[i]];
+			}
+		}
+
+		pos = pos.gather(survivors);
+
+		return old2new;
+	}
+
+
+	mesh& unique_vertex(mesh& msh, double tolerance = 1.e-12) {
+
+		size_t org_size = msh.pos.size();
+		auto indices = weld_vertices(msh.pos, tolerance);
+		size_t new_size = msh.pos.size();
+		std::cout << " vertex  " << org_size << std::endl;
+		std::cout << "ο vertex  " << new_size << std::endl;
+		std::cout << "ߺ vertex  " << org_size - new_size << std::endl;
+
+		// face to point connectivity ο ε ٲٱ
+		auto& f2v = msh.f2v.indices();
+		parallel_for(0, f2v.size(), [&](size_t i0, size_t i1) {
+			for (size_t i = i0; i < i1; ++i) {
+				f2v[i] = indices[f2v[i]];
+			}
+			});
+
+		return msh;
+	}
+
+
+	//===================================================
+	// for every row of sets, the first row holding the same values in any
+	// order (itself if none comes before). Rows are keyed by their sorted
+	// values in a lock-free open addressing table, each slot lowered to the
+	// smallest row carrying its key.
+	template<typename T>
+	std::vector<std::size_t> first_equal_sets(csr_array<T> sets) {
+
+		constexpr std::uint64_t empty = std::numeric_limits<std::uint64_t>::max();
+		size_t n = sets.size();
+		std::vector<size_t> first(n);
+		if (n == 0) return first;
+
+		std::vector<std::uint64_t> hash(n);
+		parallel_for(0, n, [&](size_t i0, size_t i1) {
+			for (size_t i = i0; i < i1; ++i) {
+				auto row = sets[i];
+				std::sort(row.begin(), row.end());
+				std::uint64_t h = row.size();
+				for (auto v : row) {
+					h ^= static_cast<std::uint64_t>(v) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+				}
+				h ^= h >> 31;
+				h *= 0xBF58476D1CE4E5B9ull;
+				h ^= h >> 27;
+				hash[i] = h;
+			}
+			});
+		auto same_key = [&](size_t a, size_t b) {
+			if (hash[a] != hash[b]) return false;
+			auto ra = sets[a];
+			auto rb = sets[b];
+			return std::equal(ra.begin(), ra.end(), rb.begin(), rb.end());
+			};
+
+		size_t num_slots = 1;
+		while (num_slots < 2 * n) num_slots <<= 1;
+		std::vector<std::uint64_t> slots(num_slots, empty);
+		parallel_for(0, n, [&](size_t i0, size_t i1) {
+			for (size_t i = i0; i < i1; ++i) {
+				for (size_t s = hash[i] & (num_slots - 1);; s = (s + 1) & (num_slots - 1)) {
+					std::atomic_ref<std::uint64_t> slot(slots[s]);
+					std::uint64_t cur = slot.load(std::memory_order_acquire);
+					if (cur == empty) {
+						if (slot.compare_exchange_strong(cur, i, std::memory_order_acq_rel)) break;
+					}
+					if (!same_key(cur, i)) continue;
+					while (i < cur && !slot.compare_exchange_weak(cur, i, std::memory_order_acq_rel)) {}
+					break;
+				}
+			}
+			});
+
+		parallel_for(0, n, [&](size_t i0, size_t i1) {
+			for (size_t i = i0; i < i1; ++i) {
+				size_t s = hash[i] & (num_slots - 1);
+				while (!same_key(slots[s], i)) s = (s + 1) & (num_slots - 1);
+				first[i] = slots[s];
+			}
+			});
+		return first;
+	}
+
+
+	//===================================================
+	// merges faces made of the same vertices, e.g. internal faces written once
+	// by each of their cells. The first face of every duplicate set survives
+	// with its vertex order, its f2c row collects the distinct cells of the
+	// whole set (its own cells first, so they stay the owner). Merged faces
+	// leave their patch, and the patch ranges follow the new face numbers.
+	mesh& unique_face(mesh& msh) {
+
+		size_t n = msh.f2v.size();
+		if (n == 0) return msh;
+
+		// first face of each key; old2new[f] <= f, so one forward sweep numbers them
+		auto old2new = first_equal_sets(msh.f2v);
+		size_t num_unique = 0;
+		for (size_t f = 0; f < n; ++f) {
+			old2new[f] = old2new[f] == f ? num_unique++ : old2new[old2new[f]];
+		}
+		auto groups = invert_rows<size_t>(n, num_unique, [&](size_t f) {
+			return std::array<size_t, 1>{ old2new[f] };
+			});
+
+		bool has_f2c = msh.f2c.size() == n;
+		auto merged_cells = [&](std::span<const size_t> group, std::vector<size_t>& cells) {
+			cells.clear();
+			for (auto f : group) {
+				for (auto c : msh.f2c[f]) {
+					if (std::find(cells.begin(), cells.end(), c) == cells.end()) cells.push_back(c);
+				}
+			}
+			};
+		std::vector<size_t> face_size(num_unique), cell_count(num_unique, 0);
+		parallel_for(0, num_unique, [&](size_t k0, size_t k1) {
+			std::vector<size_t> cells;
+			for (size_t k = k0; k < k1; ++k) {
+				face_size[k] = msh.f2v[groups[k][0]].size();
+				if (has_f2c) {
+					merged_cells(groups[k], cells);
+					cell_count[k] = cells.size();
+				}
+			}
+			});
+
+		// a duplicate seen from another cell should run the other way round
+		f2v_t f2v;
+		f2c_t f2c;
+		f2v.assign_counts(face_size);
+		if (has_f2c) f2c.assign_counts(cell_count);
+		size_t num_same_direction = 0;
+		parallel_for(0, num_unique, [&](size_t k0, size_t k1) {
+			size_t same_direction = 0;
+			std::vector<size_t> cells;
+			for (size_t k = k0; k < k1; ++k) {
+				auto group = groups[k];
+				auto first = msh.f2v[group[0]];
+				std::copy(first.begin(), first.end(), f2v[k].begin());
+				for (size_t i = 1; i < group.size() && first.size() >= 3; ++i) {
+					if (has_f2c && std::ranges::find_first_of(msh.f2c[group[i]], msh.f2c[group[0]])
+						!= msh.f2c[group[i]].end()) continue;   // a copy seen from the same cell
+					auto other = msh.f2v[group[i]];
+					size_t m = other.size();
+					size_t j = std::find(other.begin(), other.end(), first[0]) - other.begin();
+					same_direction += other[(j + 1) % m] == first[1];
+				}
+				if (has_f2c) {
+					merged_cells(group, cells);
+					std::copy(cells.begin(), cells.end(), f2c[k].begin());
+				}
+			}
+			std::atomic_ref<size_t>(num_same_direction).fetch_add(same_direction, std::memory_order_relaxed);
+			});
+
+		// merged faces are internal, so the patch ranges are set again below
+		if (msh.f2p.size() != n && !msh.patches.empty()) make_f2p_from_patches(msh);
+		if (msh.f2p.size() == n) {
+			f2p_t f2p(num_unique);
+			parallel_for(0, num_unique, [&](size_t k0, size_t k1) {
+				for (size_t k = k0; k < k1; ++k) {
+					f2p[k] = groups[k].size() > 1 ? -1 : msh.f2p[groups[k][0]];
+				}
+				});
+			msh.f2p = std::move(f2p);
+		}
+
+		msh.f2v = std::move(f2v);
+		if (has_f2c) msh.f2c = std::move(f2c);
+		group_patch_faces(msh);
+
+		std::cout << " face  " << n << std::endl;
+		std::cout << "ο face  " << num_unique << std::endl;
+		std::cout << "ߺ face  " << n - num_unique << std::endl;
+		if (num_same_direction > 0) {
+			std::cout << "unique_face : " << num_same_direction
+				<< " duplicate faces have the same orientation as the face they were merged into" << std::endl;
+		}
+
+		return msh;
+	}
+
+
+	//===================================================
+	// removes cells made of the same vertices as an earlier cell, e.g. the
+	// halo cells of overlapping pieces put together with merge_meshes and
+	// unique_vertex. f2c refers to the surviving cells; faces of removed cells
+	// only are dropped, the remaining copies of a shared face are left for
+	// unique_face; the patch ranges follow the faces that are kept. Returns
+	// the old -> new cell index.
+	std::vector<std::size_t> unique_cell(mesh& msh) {
+
+		size_t n = msh.num_cells();
+		if (n == 0) return {};
+
+		// first cell of each vertex set; old2new[c] <= c, so one forward sweep numbers them
+		auto old2new = first_equal_sets(msh.c2v());
+		std::vector<size_t> kept;
+		for (size_t c = 0; c < n; ++c) {
+			if (old2new[c] == c) {
+				old2new[c] = kept.size();
+				kept.push_back(c);
+			}
+			else {
+				old2new[c] = old2new[old2new[c]];
+			}
+		}
+		size_t num_unique = kept.size();
+		auto is_kept = [&](size_t c) { return kept[old2new[c]] == c; };
+
+		std::cout << " cell  " << n << std::endl;
+		std::cout << "ο cell  " << num_unique << std::endl;
+		std::cout << "ߺ cell  " << n - num_unique << std::endl;
+		if (num_unique == n) return old2new;
+
+		// faces still touching a kept cell (or no cell at all), with cells renumbered
+		size_t num_faces = msh.f2v.size();
+		std::vector<size_t> cell_count(num_faces, 0);
+		std::vector<char> keep_face(num_faces, 0);
+		parallel_for(0, num_faces, [&](size_t f0, size_t f1) {
+			for (size_t f = f0; f < f1; ++f) {
+				auto cells = msh.f2c[f];
+				bool keep = cells.empty();
+				for (size_t i = 0; i < cells.size(); ++i) {
+					keep |= is_kept(cells[i]);
+					bool repeated = false;
+					for (size_t j = 0; j < i; ++j) repeated |= old2new[cells[j]] == old2new[cells[i]];
+					cell_count[f] += !repeated;
+				}
+				keep_face[f] = keep;
+			}
+			});
+		std::vector<size_t> faces;
+		for (size_t f = 0; f < num_faces; ++f) {
+			if (keep_face[f]) faces.push_back(f);
+		}
+
+		f2v_t f2v;
+		f2c_t f2c;
+		std::vector<size_t> face_size(faces.size()), face_cells(faces.size());
+		for (size_t i = 0; i < faces.size(); ++i) {
+			face_size[i] = msh.f2v[faces[i]].size();
+			face_cells[i] = cell_count[faces[i]];
+		}
+		f2v.assign_counts(face_size);
+		f2c.assign_counts(face_cells);
+		parallel_for(0, faces.size(), [&](size_t i0, size_t i1) {
+			for (size_t i = i0; i < i1; ++i) {
+				auto points = msh.f2v[faces[i]];
+				std::copy(points.begin(), points.end(), f2v[i].begin());
+				auto out = f2c[i].begin();
+				auto cells = msh.f2c[faces[i]];
+				for (auto c : cells) {
+					if (std::find(f2c[i].begin(), out, old2new[c]) == out) *out++ = old2new[c];
+				}
+			}
+			});
+		if (msh.f2p.size() != num_faces && !msh.patches.empty()) make_f2p_from_patches(msh);
+		if (msh.f2p.size() == num_faces) {
+			f2p_t f2p(faces.size());
+			for (size_t i = 0; i < faces.size(); ++i) f2p[i] = msh.f2p[faces[i]];
+			msh.f2p = std::move(f2p);
+		}
+
+		// cells keep their vertex rows, which a reader may have set directly
+		c2v_t c2v = gather_rows(msh.c2v(), kept);
+
+		msh.f2v = std::move(f2v);
+		msh.f2c = std::move(f2c);
+		msh.set_c2v(std::move(c2v));
+		group_patch_faces(msh);
+
+		return old2new;
+	}
+
+
+	//===================================================
+	// renumbering for cache locality. Orders are new -> old index lists,
+	// as taken by rearrange_elements_from_indices.
+
+	// inverse of a new -> old order
+	std::vector<std::size_t> inverse_order(const std::vector<std::size_t>& order) {
+		std::vector<size_t> old2new(order.size());
+		parallel_for(0, order.size(), [&](size_t i0, size_t i1) {
+			for (size_t i = i0; i < i1; ++i) old2new[order[i]] = i;
+			});
+		return old2new;
 	}
 
-	template<typename Out, typename T>
-	std::pair< Out, Out> minmax_elements(T& container) {
-		return minmax_elements<Out>(container,
-			[](const auto& elem) { return elem; });
+	// cells sharing a face with every cell
+	csr_array<index_t> make_c2c(const mesh& msh) {
+		const auto& c2f = msh.c2f();
+		return collect_sorted_sets(c2f.size(), [&](size_t c, auto add) {
+			for (auto f : c2f[c]) {
+				for (auto d : msh.f2c[f]) {
+					if (d != c) add(d);
+				}
+			}
+			});
 	}
 
+	// Reverse Cuthill-McKee order of the cells : breadth first over the cell
+	// graph from a pseudo-peripheral cell of every connected part, neighbours
+	// by increasing degree, then reversed
+	std::vector<std::size_t> rcm_cell_order(const mesh& msh) {
+
+		auto c2c = make_c2c(msh);
+		size_t n = c2c.size();
+		auto degree = [&c2c](size_t c) { return c2c[c].size(); };
+
+		std::vector<size_t> order;
+		order.reserve(n);
+		std::vector<char> placed(n, 0);
+
+		// level sets of a breadth first search, to find a far away start cell
+		std::vector<size_t> level_mark(n, 0);
+		size_t stamp = 0;
+		std::vector<size_t> front, next;
+		auto last_level = [&](size_t start, size_t& depth) {
+			++stamp;
+			front.assign(1, start);
+			level_mark[start] = stamp;
+			depth = 0;
+			while (true) {
+				next.clear();
+				for (auto c : front) {
+					for (auto d : c2c[c]) {
+						if (level_mark[d] != stamp) {
+							level_mark[d] = stamp;
+							next.push_back(d);
+						}
+					}
+				}
+				if (next.empty()) return front;
+				front.swap(next);
+				++depth;
+			}
+			};
 
+		std::vector<size_t> by_degree(n);
+		std::iota(by_degree.begin(), by_degree.end(), 0);
+		std::stable_sort(by_degree.begin(), by_degree.end(),
+			[&](size_t a, size_t b) { return degree(a) < degree(b); });
+
+		std::vector<size_t> neighbours;
+		for (auto seed : by_degree) {
+			if (placed[seed]) continue;
+
+			size_t start = seed;
+			size_t depth = 0;
+			auto last = last_level(start, depth);
+			for (int iter = 0; iter < 8; ++iter) {
+				size_t candidate = *std::min_element(last.begin(), last.end(),
+					[&](size_t a, size_t b) { return degree(a) < degree(b); });
+				size_t candidate_depth = 0;
+				auto candidate_last = last_level(candidate, candidate_depth);
+				if (candidate_depth <= depth) break;
+				start = candidate;
+				depth = candidate_depth;
+				last = std::move(candidate_last);
+			}
 
+			size_t head = order.size();
+			order.push_back(start);
+			placed[start] = 1;
+			while (head < order.size()) {
+				size_t c = order[head++];
+				neighbours.clear();
+				for (auto d : c2c[c]) {
+					if (!placed[d]) {
+						placed[d] = 1;
+						neighbours.push_back(d);
+					}
+				}
+				std::stable_sort(neighbours.begin(), neighbours.end(),
+					[&](size_t a, size_t b) { return degree(a) < degree(b); });
+				order.insert(order.end(), neighbours.begin(), neighbours.end());
+			}
+		}
+		std::reverse(order.begin(), order.end());
+		return order;
+	}
 
-	//===================================================
-	// myVector ҵ indices  ű
-	template<typename T>
-	void rearrange_elements_to_indices_mutable(std::vector<T>& myVector,
-		std::vector<std::size_t>& indices) {
-		std::size_t size = myVector.size();
+	enum class space_filling_curve { hilbert, morton };
 
-		//  ε   ġ Ҹ ǥ ġ swapմϴ.
-		for (std::size_t i = 0; i < size; ++i) {
-			while (indices[i] != i) {
-				std::swap(myVector[i], myVector[indices[i]]);
-				std::swap(indices[i], indices[indices[i]]);
+	// points sorted along a space filling curve through their bounding box,
+	// 21 bits per axis
+	std::vector<std::size_t> curve_order(const pos_t& points, space_filling_curve curve) {
+
+		size_t n = points.size();
+		std::vector<size_t> order(n);
+		if (n == 0) return order;
+
+		std::array<double, 3> lo = points[0], hi = points[0];
+		for (const auto& p : points) {
+			for (int k = 0; k < 3; ++k) {
+				lo[k] = std::min(lo[k], p[k]);
+				hi[k] = std::max(hi[k], p[k]);
 			}
 		}
+		constexpr int bits = 21;
+		constexpr std::uint32_t top = (1u << bits) - 1;
+		std::array<double, 3> scale{};
+		for (int k = 0; k < 3; ++k) {
+			scale[k] = hi[k] > lo[k] ? top / (hi[k] - lo[k]) : 0.0;
+		}
+
+		std::vector<std::pair<std::uint64_t, size_t>> keys(n);
+		parallel_for(0, n, [&](size_t i0, size_t i1) {
+			for (size_t i = i0; i < i1; ++i) {
+				std::array<std::uint32_t, 3> x;
+				for (int k = 0; k < 3; ++k) {
+					x[k] = std::min(top, static_cast<std::uint32_t>((points[i][k] - lo[k]) * scale[k]));
+				}
+				if (curve == space_filling_curve::hilbert) {
+					// axes to transposed Hilbert index (J. Skilling, 2004)
+					for (std::uint32_t q = 1u << (bits - 1); q > 1; q >>= 1) {
+						std::uint32_t p = q - 1;
+						for (int k = 0; k < 3; ++k) {
+							if (x[k] & q) {
+								x[0] ^= p;
+							}
+							else {
+								std::uint32_t t = (x[0] ^ x[k]) & p;
+								x[0] ^= t;
+								x[k] ^= t;
+							}
+						}
+					}
+					for (int k = 1; k < 3; ++k) x[k] ^= x[k - 1];
+					std::uint32_t t = 0;
+					for (std::uint32_t q = 1u << (bits - 1); q > 1; q >>= 1) {
+						if (x[2] & q) t ^= q - 1;
+					}
+					for (int k = 0; k < 3; ++k) x[k] ^= t;
+				}
+				std::uint64_t key = 0;
+				for (int b = bits - 1; b >= 0; --b) {
+					for (int k = 0; k < 3; ++k) key = (key << 1) | ((x[k] >> b) & 1u);
+				}
+				keys[i] = { key, i };
+			}
+			});
+
+		std::sort(keys.begin(), keys.end());
+		for (size_t i = 0; i < n; ++i) order[i] = keys[i].second;
+		return order;
 	}
 
-	// myVector ҵ indices  ű
-	template<typename T>
-	void rearrange_elements_to_indices(std::vector<T>& myVector,
-		std::vector<std::size_t>& indices) {
-		std::vector<std::size_t> copy_indices(indices);
-		rearrange_elements_to_indices_mutable(myVector, copy_indices);
+	// average of the points of every cell
+	pos_t cell_point_averages(const mesh& msh) {
+		const auto& c2v = msh.c2v();
+		pos_t centres(c2v.size());
+		parallel_for(0, c2v.size(), [&](size_t c0, size_t c1) {
+			for (size_t c = c0; c < c1; ++c) {
+				auto points = c2v[c];
+				std::array<double, 3> sum{};
+				for (auto v : points) {
+					for (int k = 0; k < 3; ++k) sum[k] += msh.pos[v][k];
+				}
+				double count = static_cast<double>(std::max<size_t>(1, points.size()));
+				centres.set(c, sum[0] / count, sum[1] / count, sum[2] / count);
+			}
+			});
+		return centres;
 	}
 
-	// indices ġ myVector Ҹ ű
-	template<typename T>
-	void rearrange_elements_from_indices(std::vector<T>& myVector,
-		std::vector<std::size_t>& indices) {
-		std::size_t size = myVector.size();
-		std::vector<std::size_t> copy_indices(size);
-		for (std::size_t i = 0; i < size; ++i) {
-			copy_indices[indices[i]] = i;
+	// internal faces by (lower cell, upper cell), then boundary faces by cell;
+	// renumber_faces sorts the boundary faces by patch first
+	std::vector<std::size_t> face_order_by_cells(const mesh& msh) {
+		size_t n = msh.f2c.size();
+		size_t num_cells = msh.num_cells();
+		auto lower = [&](size_t f) {
+			auto cells = msh.f2c[f];
+			if (cells.empty()) return 2 * num_cells;
+			if (cells.size() == 1) return num_cells + cells[0];
+			return static_cast<size_t>(std::min(cells[0], cells[1]));
+			};
+		auto upper = [&](size_t f) {
+			auto cells = msh.f2c[f];
+			return cells.size() < 2 ? 0 : std::max(cells[0], cells[1]);
+			};
+
+		// counting sort by the lower cell, then each group by the upper one
+		auto groups = invert_rows<size_t>(n, 2 * num_cells + 1, [&](size_t f) {
+			return std::array<size_t, 1>{ lower(f) };
+			});
+		parallel_for(0, groups.size(), [&](size_t g0, size_t g1) {
+			for (size_t g = g0; g < g1; ++g) {
+				auto row = groups[g];
+				std::stable_sort(row.begin(), row.end(), [&](size_t a, size_t b) { return upper(a) < upper(b); });
+			}
+			});
+		return std::move(groups.indices());
+	}
+
+	// points in the order the faces first use them
+	std::vector<std::size_t> point_order_by_faces(const mesh& msh) {
+		constexpr size_t none = std::numeric_limits<size_t>::max();
+		std::vector<size_t> old2new(msh.pos.size(), none);
+		std::vector<size_t> order;
+		order.reserve(msh.pos.size());
+		for (auto v : msh.f2v.indices()) {
+			if (old2new[v] == none) {
+				old2new[v] = order.size();
+				order.push_back(v);
+			}
 		}
-		rearrange_elements_to_indices_mutable(myVector, copy_indices);
+		for (size_t v = 0; v < msh.pos.size(); ++v) {
+			if (old2new[v] == none) order.push_back(v);
+		}
+		return order;
+	}
+
+	// pos moved to the new order, f2v and c2v renumbered
+	void renumber_points(mesh& msh, const std::vector<std::size_t>& order) {
+		auto old2new = inverse_order(order);
+		c2v_t c2v = msh.c2v();
+		msh.pos = msh.pos.gather(order);
+		for (auto* conn : { &msh.f2v, &c2v }) {
+			auto& indices = conn->indices();
+			parallel_for(0, indices.size(), [&](size_t i0, size_t i1) {
+				for (size_t i = i0; i < i1; ++i) indices[i] = old2new[indices[i]];
+				});
+		}
+		msh.set_c2v(std::move(c2v));
 	}
 
+	// c2f / c2v rows moved to the new order, f2c renumbered
+	void renumber_cells(mesh& msh, const std::vector<std::size_t>& order) {
+		auto old2new = inverse_order(order);
+		c2f_t c2f = gather_rows(msh.c2f(), order);
+		c2v_t c2v = gather_rows(msh.c2v(), order);
+		auto& cells = msh.f2c.indices();
+		parallel_for(0, cells.size(), [&](size_t i0, size_t i1) {
+			for (size_t i = i0; i < i1; ++i) cells[i] = old2new[cells[i]];
+			});
+		msh.set_c2f(std::move(c2f));
+		msh.set_c2v(std::move(c2v));
+	}
 
+	// f2v / f2c / f2p moved to the new order, c2f renumbered. The faces of a
+	// patch stay together : after the faces in no patch, patch by patch, each
+	// in the given order, with the patch ranges set to match. Returns the
+	// order applied.
+	std::vector<std::size_t> renumber_faces(mesh& msh, const std::vector<std::size_t>& order) {
+		size_t n = msh.f2v.size();
+		if (msh.f2p.size() != n && !msh.patches.empty()) make_f2p_from_patches(msh);
+		bool has_f2p = msh.f2p.size() == n;
+		csr_array<size_t> by_patch;
+		std::vector<size_t> grouped = order;
+		if (has_f2p) {
+			by_patch = faces_by_patch(msh.f2p, msh.patches.size(), order);
+			grouped = by_patch.indices();
+		}
 
-	//===================================================
-	// Լ α׷
-	template <typename F>
-	auto compose(F&& f)
-	{
-		return [a = std::move(f)](auto&&... args) {
-			return a(std::move(args)...);
-			};
+		bool moved = false;
+		for (size_t i = 0; i < n && !moved; ++i) moved = grouped[i] != i;
+		if (moved) {
+			auto old2new = inverse_order(grouped);
+			c2f_t c2f = msh.c2f();
+			c2v_t c2v = msh.c2v();
+			auto& faces = c2f.indices();
+			parallel_for(0, faces.size(), [&](size_t i0, size_t i1) {
+				for (size_t i = i0; i < i1; ++i) faces[i] = old2new[faces[i]];
+				});
+			if (has_f2p) rearrange_elements_from_indices(msh.f2p, grouped);
+			msh.f2v = gather_rows(msh.f2v, grouped);
+			if (msh.f2c.size() == n) msh.f2c = gather_rows(msh.f2c, grouped);
+			msh.set_c2f(std::move(c2f));
+			msh.set_c2v(std::move(c2v));
+		}
+		if (has_f2p) set_patch_ranges(msh.patches, by_patch);
+		return grouped;
 	}
 
-	template <typename F1, typename F2, typename... Fs>
-	auto compose(F1&& f1, F2&& f2, Fs&&... fs)
-	{
-		return compose(
-			[first = std::move(f1), second = std::move(f2)]
-			(auto&&... args) {
-				return second(first(std::move(args)...));
-			},
-			std::move(fs)...
-		);
+	// faces of every patch moved together, in patch order after the faces in no
+	// patch, and the patch ranges set to match. Returns the new -> old face order.
+	std::vector<std::size_t> group_patch_faces(mesh& msh) {
+		std::vector<size_t> order(msh.f2v.size());
+		std::iota(order.begin(), order.end(), 0);
+		return renumber_faces(msh, order);
 	}
 
+	enum class renumbering { rcm, hilbert, morton };
 
-	template <typename... Funcs>
-	decltype(auto) combine(Funcs... fs) {
-		return [fs...](auto... inps) {
-			(fs(inps...), ...);
-			};
+	// cells by RCM or along a curve through their centres, faces after their
+	// cells, points in first use by the faces (rcm) or along the same curve
+	mesh& renumber_mesh(mesh& msh, renumbering method) {
+		auto curve = method == renumbering::morton ? space_filling_curve::morton : space_filling_curve::hilbert;
+		if (msh.num_cells() > 0) {
+			renumber_cells(msh, method == renumbering::rcm ? rcm_cell_order(msh) : curve_order(cell_point_averages(msh), curve));
+			renumber_faces(msh, face_order_by_cells(msh));
+		}
+		renumber_points(msh, method == renumbering::rcm ? point_order_by_faces(msh) : curve_order(msh.pos, curve));
+		return msh;
 	}
 
 
 	//===================================================
-	// ִ Ȯ
-	template <typename Container, typename Value>
-	bool is_there(Container& inp, Value value) {
-		return std::find(inp.begin(), inp.end(), value) != inp.end();
-	}
+	// partitioning : a part id per cell
+
+	// recursive coordinate bisection : the box around the points is cut across
+	// its longest side, the two sides getting counts in proportion to their parts
+	std::vector<std::int32_t> partition_rcb(const pos_t& points, std::size_t num_parts) {
+
+		size_t n = points.size();
+		std::vector<int32_t> part(n, 0);
+		std::vector<size_t> ids(n);
+		std::iota(ids.begin(), ids.end(), 0);
+
+		struct range { size_t begin, end, part0, num_parts; };
+		std::vector<range> todo{ { 0, n, 0, std::max<size_t>(1, num_parts) } };
+		while (!todo.empty()) {
+			range r = todo.back();
+			todo.pop_back();
+			if (r.num_parts == 1 || r.end - r.begin <= 1) {
+				for (size_t i = r.begin; i < r.end; ++i) part[ids[i]] = static_cast<int32_t>(r.part0);
+				continue;
+			}
 
-	//===================================================
-	// input  ε  ִ ͸ , ε κ Ѳ ȿ 
-	template<typename T, typename Container2>
-	void erase_elements_by_indices(std::vector<T>& myVector,
-		const Container2& indices) {
-		std::size_t size = myVector.size();
-		std::vector<bool> to_remove(size, false);
-		for (auto i : indices) {
-			to_remove[i] = true;
+			std::array<double, 3> lo = points[ids[r.begin]], hi = lo;
+			for (size_t i = r.begin; i < r.end; ++i) {
+				for (int k = 0; k < 3; ++k) {
+					double x = points[ids[i]][k];
+					lo[k] = std::min(lo[k], x);
+					hi[k] = std::max(hi[k], x);
+				}
+			}
+			int axis = 0;
+			for (int k = 1; k < 3; ++k) {
+				if (hi[k] - lo[k] > hi[axis] - lo[axis]) axis = k;
+			}
+
+			size_t left_parts = r.num_parts / 2;
+			size_t mid = r.begin + (r.end - r.begin) * left_parts / r.num_parts;
+			std::nth_element(ids.begin() + r.begin, ids.begin() + mid, ids.begin() + r.end, [&](size_t a, size_t b) {
+				return points[a][axis] < points[b][axis] || (points[a][axis] == points[b][axis] && a < b);
+				});
+			todo.push_back({ r.begin, mid, r.part0, left_parts });
+			todo.push_back({ mid, r.end, r.part0 + left_parts, r.num_parts - left_parts });
 		}
-		std::size_t i = 0;
-		myVector.erase(
-			std::remove_if(myVector.begin(), myVector.end(),
-				[&to_remove, i](const auto&) mutable {
-					return to_remove[i++];
-				}),
-			myVector.end());
+		return part;
 	}
 
 
+	// multilevel recursive bisection of a weighted graph : the graph is
+	// coarsened by heavy edge matching, the coarsest one split by greedy
+	// growing from a few seeds, and the split refined level by level on the
+	// way back by moving boundary vertices that cut fewer edges
+	class graph_partitioner {
+	public:
+		// allowed deviation of a side's weight from its target, as a fraction
+		void set_imbalance(double imbalance) { imbalance_ = imbalance; }
+
+		// part id per cell; cells are joined through their faces
+		std::vector<std::int32_t> partition(const mesh& msh, std::size_t num_parts) const {
+			graph g;
+			g.adjacency = make_c2c(msh);
+			g.edge_weights.assign(g.adjacency.num_entries(), 1);
+			g.vertex_weights.assign(g.adjacency.size(), 1);
+			return partition(g, num_parts);
+		}
 
+		struct graph {
+			csr_array<index_t> adjacency;
+			std::vector<size_t> edge_weights;     // aligned with adjacency.indices()
+			std::vector<size_t> vertex_weights;
 
-	mesh& unique_vertex(mesh& msh) {
+			size_t size() const { return adjacency.size(); }
+			size_t total_weight() const {
+				return std::accumulate(vertex_weights.begin(), vertex_weights.end(), size_t{ 0 });
+			}
+		};
+
+		std::vector<std::int32_t> partition(const graph& g, std::size_t num_parts) const {
+			std::vector<int32_t> part(g.size(), 0);
+			std::vector<size_t> ids(g.size());
+			std::iota(ids.begin(), ids.end(), 0);
+			split(g, ids, 0, std::max<size_t>(1, num_parts), part);
+			return part;
+		}
 
-		size_t org_size = msh.pos.size();
-		auto indices = sort_and_unique_indices(msh.pos);
-		size_t new_size = msh.pos.size();
-		std::cout << " vertex  " << org_size << std::endl;
-		std::cout << "ο vertex  " << new_size << std::endl;
-		std::cout << "ߺ vertex  " << org_size - new_size << std::endl;
+	private:
+		double imbalance_ = 0.03;
 
-		// face to point connectivity ο ε ٲٱ
-		for (auto& points : msh.f2v) {
-			std::vector<std::size_t> new_points;
-			for (const auto& point : points) {
-				new_points.push_back(indices[point]);
+		// parts part0 ... part0 + num_parts - 1 for the vertices ids of g
+		void split(const graph& g, const std::vector<size_t>& ids, size_t part0, size_t num_parts,
+			std::vector<int32_t>& part) const {
+
+			if (num_parts == 1 || g.size() <= 1) {
+				for (auto v : ids) part[v] = static_cast<int32_t>(part0);
+				return;
 			}
-			points = std::move(new_points);
+			// each cut may miss by the allowed imbalance of one part
+			size_t left_parts = num_parts / 2;
+			auto side = bisect(g, static_cast<double>(left_parts) / num_parts, imbalance_ / num_parts, part0);
+
+			// both halves are split further concurrently
+			std::array<graph, 2> halves;
+			std::array<std::vector<size_t>, 2> half_ids;
+			for (int s = 0; s < 2; ++s) {
+				std::vector<size_t> vertices;
+				for (size_t v = 0; v < g.size(); ++v) {
+					if (side[v] == s) vertices.push_back(v);
+				}
+				halves[s] = induced(g, vertices);
+				for (auto v : vertices) half_ids[s].push_back(ids[v]);
+			}
+			parallel_for(0, 2, [&](size_t s0, size_t s1) {
+				for (size_t s = s0; s < s1; ++s) {
+					split(halves[s], half_ids[s], s == 0 ? part0 : part0 + left_parts,
+						s == 0 ? left_parts : num_parts - left_parts, part);
+				}
+				}, 1);
 		}
 
-		return msh;
+		// subgraph on the given vertices, renumbered in that order
+		static graph induced(const graph& g, const std::vector<size_t>& vertices) {
+			constexpr size_t none = std::numeric_limits<size_t>::max();
+			std::vector<size_t> local(g.size(), none);
+			for (size_t i = 0; i < vertices.size(); ++i) local[vertices[i]] = i;
+
+			graph sub;
+			sub.vertex_weights.resize(vertices.size());
+			sub.adjacency.reserve(vertices.size(), 0);
+			for (size_t i = 0; i < vertices.size(); ++i) {
+				size_t v = vertices[i];
+				sub.vertex_weights[i] = g.vertex_weights[v];
+				sub.adjacency.emplace_back();
+				size_t e0 = g.adjacency.offsets()[v];
+				auto row = g.adjacency[v];
+				for (size_t k = 0; k < row.size(); ++k) {
+					if (local[row[k]] == none) continue;
+					sub.adjacency.append_to_back(local[row[k]]);
+					sub.edge_weights.push_back(g.edge_weights[e0 + k]);
+				}
+			}
+			return sub;
+		}
+
+		// heavy edge matching; map receives the coarse vertex of every vertex
+		static graph coarsen(const graph& g, std::vector<size_t>& map, std::mt19937& random) {
+			constexpr size_t none = std::numeric_limits<size_t>::max();
+			size_t n = g.size();
+			std::vector<size_t> visit(n);
+			std::iota(visit.begin(), visit.end(), 0);
+			std::shuffle(visit.begin(), visit.end(), random);
+
+			map.assign(n, none);
+			size_t num_coarse = 0;
+			for (auto v : visit) {
+				if (map[v] != none) continue;
+				size_t e0 = g.adjacency.offsets()[v];
+				auto row = g.adjacency[v];
+				size_t mate = v;
+				size_t heaviest = 0;
+				for (size_t k = 0; k < row.size(); ++k) {
+					if (map[row[k]] == none && row[k] != v && g.edge_weights[e0 + k] > heaviest) {
+						heaviest = g.edge_weights[e0 + k];
+						mate = row[k];
+					}
+				}
+				map[v] = map[mate] = num_coarse++;
+			}
+
+			// coarse rows merge the rows of their vertices, summing the weights
+			auto members = invert_rows<size_t>(n, num_coarse, [&](size_t v) {
+				return std::array<size_t, 1>{ map[v] };
+				});
+			graph coarse;
+			coarse.vertex_weights.assign(num_coarse, 0);
+			coarse.adjacency.reserve(num_coarse, 0);
+			std::vector<size_t> slot(num_coarse, none);
+			for (size_t c = 0; c < num_coarse; ++c) {
+				coarse.adjacency.emplace_back();
+				size_t first = coarse.edge_weights.size();
+				for (auto v : members[c]) {
+					coarse.vertex_weights[c] += g.vertex_weights[v];
+					size_t e0 = g.adjacency.offsets()[v];
+					auto row = g.adjacency[v];
+					for (size_t k = 0; k < row.size(); ++k) {
+						size_t d = map[row[k]];
+						if (d == c) continue;
+						if (slot[d] == none) {
+							slot[d] = coarse.edge_weights.size();
+							coarse.adjacency.append_to_back(d);
+							coarse.edge_weights.push_back(0);
+						}
+						coarse.edge_weights[slot[d]] += g.edge_weights[e0 + k];
+					}
+				}
+				for (size_t e = first; e < coarse.edge_weights.size(); ++e) {
+					slot[coarse.adjacency.indices()[e]] = none;
+				}
+			}
+			return coarse;
+		}
+
+		static size_t cut_weight(const graph& g, const std::vector<std::uint8_t>& side) {
+			size_t cut = 0;
+			for (size_t v = 0; v < g.size(); ++v) {
+				size_t e0 = g.adjacency.offsets()[v];
+				auto row = g.adjacency[v];
+				for (size_t k = 0; k < row.size(); ++k) {
+					if (side[row[k]] != side[v]) cut += g.edge_weights[e0 + k];
+				}
+			}
+			return cut / 2;
+		}
+
+		// side 0 grown breadth first from seed until it holds target weight
+		static std::vector<std::uint8_t> grow(const graph& g, size_t seed, size_t target) {
+			size_t n = g.size();
+			std::vector<std::uint8_t> side(n, 1);
+			std::vector<char> queued(n, 0);
+			std::vector<size_t> queue{ seed };
+			queued[seed] = 1;
+			size_t weight = 0;
+			size_t head = 0;
+			size_t next_seed = 0;
+			while (weight < target) {
+				if (head == queue.size()) {
+					// disconnected graph : continue from the next vertex not taken yet
+					while (next_seed < n && queued[next_seed]) ++next_seed;
+					if (next_seed == n) break;
+					queue.push_back(next_seed);
+					queued[next_seed] = 1;
+				}
+				size_t v = queue[head++];
+				side[v] = 0;
+				weight += g.vertex_weights[v];
+				for (auto d : g.adjacency[v]) {
+					if (!queued[d]) {
+						queued[d] = 1;
+						queue.push_back(d);
+					}
+				}
+			}
+			return side;
+		}
+
+		// Fiduccia-Mattheyses passes : the boundary vertex of best gain moves
+		// next, each vertex once per pass, also when that costs cut for a while;
+		// the pass is then rolled back to its best point. An unbalanced split is
+		// first brought back within tolerance from its heavy side.
+		static void refine(const graph& g, std::vector<std::uint8_t>& side, size_t target, double tolerance) {
+			size_t n = g.size();
+			std::int64_t weight0 = 0;
+			for (size_t v = 0; v < n; ++v) {
+				if (side[v] == 0) weight0 += g.vertex_weights[v];
+			}
+			auto deviation = [&](std::int64_t w) { return std::abs(static_cast<double>(w) - static_cast<double>(target)); };
+			auto weight_after = [&](size_t v) {
+				std::int64_t vw = static_cast<std::int64_t>(g.vertex_weights[v]);
+				return side[v] == 0 ? weight0 - vw : weight0 + vw;
+				};
+
+			// cut weight saved by moving v
+			std::vector<std::int64_t> gain(n, 0);
+			std::vector<char> boundary(n, 0);
+			auto update = [&](size_t v) {
+				size_t e0 = g.adjacency.offsets()[v];
+				auto row = g.adjacency[v];
+				gain[v] = 0;
+				boundary[v] = 0;
+				for (size_t k = 0; k < row.size(); ++k) {
+					std::int64_t w = static_cast<std::int64_t>(g.edge_weights[e0 + k]);
+					bool across = side[row[k]] != side[v];
+					gain[v] += across ? w : -w;
+					boundary[v] |= across;
+				}
+				};
+			for (size_t v = 0; v < n; ++v) update(v);
+
+			using entry = std::pair<std::int64_t, size_t>;
+			std::priority_queue<entry> heap;
+			std::vector<char> locked(n, 0);
+			std::vector<size_t> moves;
+			auto move = [&](size_t v) {
+				weight0 = weight_after(v);
+				side[v] ^= 1;
+				update(v);
+				for (auto u : g.adjacency[v]) {
+					update(u);
+					if (!locked[u] && boundary[u]) heap.push({ gain[u], u });
+				}
+				};
+
+			// balance first
+			if (deviation(weight0) > tolerance) {
+				for (size_t v = 0; v < n; ++v) {
+					if (boundary[v]) heap.push({ gain[v], v });
+				}
+				while (!heap.empty() && deviation(weight0) > tolerance) {
+					auto [key, v] = heap.top();
+					heap.pop();
+					if (key != gain[v] || !boundary[v]) continue;
+					if (deviation(weight_after(v)) >= deviation(weight0)) continue;
+					move(v);
+				}
+				heap = {};
+			}
+
+			size_t patience = 64 + n / 100;
+			for (int pass = 0; pass < 8; ++pass) {
+				std::fill(locked.begin(), locked.end(), 0);
+				for (size_t v = 0; v < n; ++v) {
+					if (boundary[v]) heap.push({ gain[v], v });
+				}
+				moves.clear();
+				std::int64_t total = 0, best = 0;
+				size_t best_moves = 0;
+				while (!heap.empty() && moves.size() - best_moves < patience) {
+					auto [key, v] = heap.top();
+					heap.pop();
+					if (locked[v] || key != gain[v] || !boundary[v]) continue;
+					if (deviation(weight_after(v)) > tolerance) continue;
+					total += gain[v];
+					locked[v] = 1;
+					move(v);
+					moves.push_back(v);
+					if (total > best) {
+						best = total;
+						best_moves = moves.size();
+					}
+				}
+				heap = {};
+				// undo the moves after the best point
+				for (size_t i = moves.size(); i-- > best_moves;) {
+					size_t v = moves[i];
+					weight0 = weight_after(v);
+					side[v] ^= 1;
+				}
+				if (best_moves < moves.size()) {
+					for (size_t i = best_moves; i < moves.size(); ++i) {
+						update(moves[i]);
+						for (auto u : g.adjacency[moves[i]]) update(u);
+					}
+				}
+				if (best == 0) break;
+			}
+		}
+
+		// side 0 gets about fraction of the weight, give or take tolerance of the total
+		static std::vector<std::uint8_t> bisect(const graph& g, double fraction, double tolerance, size_t seed) {
+
+			std::mt19937 random(static_cast<std::mt19937::result_type>(seed * 7919 + g.size()));
+
+			std::vector<graph> levels;
+			std::vector<std::vector<size_t>> maps;
+			const graph* current = &g;
+			while (current->size() > 128) {
+				std::vector<size_t> map;
+				graph coarse = coarsen(*current, map, random);
+				if (coarse.size() > current->size() * 9 / 10) break;
+				maps.push_back(std::move(map));
+				levels.push_back(std::move(coarse));
+				current = &levels.back();
+			}
+
+			// best of a few grown splits of the coarsest graph
+			auto allowed = [&](const graph& level) {
+				size_t heaviest = *std::max_element(level.vertex_weights.begin(), level.vertex_weights.end());
+				return std::max(static_cast<double>(heaviest), tolerance * level.total_weight());
+				};
+			size_t target = static_cast<size_t>(fraction * current->total_weight());
+			std::vector<std::uint8_t> side;
+			size_t best_cut = std::numeric_limits<size_t>::max();
+			std::uniform_int_distribution<size_t> pick(0, current->size() - 1);
+			for (int trial = 0; trial < 8; ++trial) {
+				auto trial_side = grow(*current, pick(random), target);
+				refine(*current, trial_side, target, allowed(*current));
+				size_t cut = cut_weight(*current, trial_side);
+				if (cut < best_cut) {
+					best_cut = cut;
+					side = std::move(trial_side);
+				}
+			}
+
+			// project back level by level, refining on the way
+			for (size_t l = levels.size(); l-- > 0;) {
+				const graph& fine = l == 0 ? g : levels[l - 1];
+				std::vector<std::uint8_t> fine_side(fine.size());
+				for (size_t v = 0; v < fine.size(); ++v) fine_side[v] = side[maps[l][v]];
+				side = std::move(fine_side);
+				refine(fine, side, static_cast<size_t>(fraction * fine.total_weight()), allowed(fine));
+			}
+			return side;
+		}
+	};
+
+
+	enum class partition_method { rcb, graph };
+
+	// part id per cell, by coordinate bisection of the cell centres or by the
+	// multilevel graph partitioner on the cells joined through their faces
+	std::vector<std::int32_t> partition_cells(const mesh& msh, std::size_t num_parts,
+		partition_method method = partition_method::graph) {
+		if (method == partition_method::rcb) return partition_rcb(cell_point_averages(msh), num_parts);
+		return graph_partitioner().partition(msh, num_parts);
 	}
 
+	// one sub mesh per part, extracted concurrently. Faces between parts go
+	// to processor patches procBoundary<part>to<neighbour>, turned to point
+	// out of their cell, after the patches of msh.
+	std::vector<mesh> split_mesh(const mesh& msh, const std::vector<std::int32_t>& part, std::size_t num_parts) {
 
-	mesh& unique_face(mesh& msh) {
+		// part ids become row numbers below, so one out of range would write
+		// out of bounds
+		if (part.size() != msh.num_cells()) {
+			std::cerr << "Error: split_mesh got " << part.size() << " part ids for " << msh.num_cells() << " cells" << std::endl;
+			return {};
+		}
+		auto bad = std::find_if(part.begin(), part.end(), [&](std::int32_t q) {
+			return q < 0 || static_cast<size_t>(q) >= num_parts;
+			});
+		if (bad != part.end()) {
+			std::cerr << "Error: split_mesh part id " << *bad << " of cell " << (bad - part.begin()) << " is not in [0, " << num_parts << ")" << std::endl;
+			return {};
+		}
 
+		// derive the cached connectivity once, before the threads read it
+		msh.c2f();
+		msh.c2v();
 
+		auto part_cells = invert_rows<size_t>(part.size(), num_parts, [&](size_t c) {
+			return std::array<size_t, 1>{ static_cast<size_t>(part[c]) };
+			});
 
+		std::vector<mesh> pieces(num_parts);
+		parallel_for(0, num_parts, [&](size_t p0, size_t p1) {
+			for (size_t p = p0; p < p1; ++p) {
+				auto cells = part_cells[p];
+				std::vector<size_t> faces;
+				mesh piece = extract_cells(msh, std::span<const size_t>(cells.data(), cells.size()), &faces);
+				if (piece.f2p.size() != faces.size()) piece.f2p.assign(faces.size(), -1);
+
+				// neighbour part of every face between parts
+				std::vector<int32_t> neighbour(faces.size(), -1);
+				for (size_t i = 0; i < faces.size(); ++i) {
+					auto global = msh.f2c[faces[i]];
+					if (global.size() != 2) continue;
+					bool owner_here = part[global[0]] == static_cast<int32_t>(p);
+					int32_t other = part[global[owner_here ? 1 : 0]];
+					if (other == static_cast<int32_t>(p)) continue;
+					neighbour[i] = other;
+					if (!owner_here) {
+						auto row = piece.f2v[i];
+						std::reverse(row.begin(), row.end());
+					}
+				}
 
+				std::vector<int32_t> patch_of(num_parts, -1);
+				for (size_t i = 0; i < faces.size(); ++i) {
+					if (neighbour[i] >= 0) patch_of[neighbour[i]] = 0;
+				}
+				for (size_t q = 0; q < num_parts; ++q) {
+					if (patch_of[q] < 0) continue;
+					patch_of[q] = static_cast<int32_t>(piece.patches.size());
+					patch pt;
+					pt.name = "procBoundary" + std::to_string(p) + "to" + std::to_string(q);
+					pt.type = "processor";
+					pt.my_proc_no = static_cast<int>(p);
+					pt.neighb_proc_no = static_cast<int>(q);
+					piece.patches.push_back(std::move(pt));
+				}
+				for (size_t i = 0; i < faces.size(); ++i) {
+					if (neighbour[i] >= 0) piece.f2p[i] = patch_of[neighbour[i]];
+				}
+				group_patch_faces(piece);
+				pieces[p] = std::move(piece);
+			}
+			}, 1);
+		return pieces;
+	}
 
 
-		return msh;
+	//===================================================
+	// geometry of all faces and cells, computed in parallel over separate
+	// double x, y and z arrays of the points
+
+	struct point_soa {
+		const double* x = nullptr;
+		const double* y = nullptr;
+		const double* z = nullptr;
+		std::vector<double> copy;   // empty when x, y and z are the mesh arrays
+	};
+
+	// the mesh arrays themselves when points are stored that way, a copy otherwise
+	template<typename Real, bool SoA>
+	point_soa make_point_soa(const point_array<Real, SoA>& pos) {
+		point_soa soa;
+		if constexpr (SoA && std::is_same_v<Real, double>) {
+			soa.x = pos.data(0);
+			soa.y = pos.data(1);
+			soa.z = pos.data(2);
+			return soa;
+		}
+		size_t n = pos.size();
+		soa.copy.resize(3 * n);
+		parallel_for(0, n, [&](size_t i0, size_t i1) {
+			for (size_t i = i0; i < i1; ++i) {
+				for (int k = 0; k < 3; ++k) soa.copy[k * n + i] = pos[i][k];
+			}
+			});
+		soa.x = soa.copy.data();
+		soa.y = soa.x + n;
+		soa.z = soa.y + n;
+		return soa;
 	}
 
+	// centre, unit normal (right hand rule over the f2v order) and area of every face
+	struct face_geometry {
+		std::vector<double> cx, cy, cz;
+		std::vector<double> nx, ny, nz;
+		std::vector<double> area;
+
+		size_t size() const { return area.size(); }
+		void resize(size_t n) {
+			for (auto* v : { &cx, &cy, &cz, &nx, &ny, &nz, &area }) v->resize(n);
+		}
+	};
+
+	// centre and volume of every cell; volumes of inside-out cells come out negative
+	struct cell_geometry {
+		std::vector<double> cx, cy, cz;
+		std::vector<double> volume;
+
+		size_t size() const { return volume.size(); }
+		void resize(size_t n) {
+			for (auto* v : { &cx, &cy, &cz, &volume }) v->resize(n);
+		}
+	};
 
-	mesh& unique_cell(mesh& msh) {
+	// faces[0] ... faces[count - 1], each a polygon of K points (K = 0 : any
+	// number). Triangles are taken as they are; larger polygons are fanned
+	// around their point average and the centre is the area weighted mean of
+	// the fan triangles. A fixed K lets the compiler unroll the point loop
+	// and vectorise across faces.
+	template<int K>
+	void polygon_geometry(const point_soa& p, const f2v_t& f2v, const size_t* faces, size_t count,
+		face_geometry& out) {
+
+		const size_t* offsets = f2v.offsets().data();
+		const index_t* points = f2v.indices().data();
+		const double* px = p.x;
+		const double* py = p.y;
+		const double* pz = p.z;
+
+		for (size_t i = 0; i < count; ++i) {
+			size_t f = faces[i];
+			const index_t* v = points + offsets[f];
+			size_t n = K > 0 ? static_cast<size_t>(K) : offsets[f + 1] - offsets[f];
+
+			double ex = 0.0, ey = 0.0, ez = 0.0;
+			for (size_t j = 0; j < n; ++j) {
+				ex += px[v[j]];
+				ey += py[v[j]];
+				ez += pz[v[j]];
+			}
+			double inv = n > 0 ? 1.0 / static_cast<double>(n) : 0.0;
+			ex *= inv;
+			ey *= inv;
+			ez *= inv;
+
+			double sx, sy, sz, cx = ex, cy = ey, cz = ez;
+			if (n == 3) {
+				double ux = px[v[1]] - px[v[0]], uy = py[v[1]] - py[v[0]], uz = pz[v[1]] - pz[v[0]];
+				double wx = px[v[2]] - px[v[0]], wy = py[v[2]] - py[v[0]], wz = pz[v[2]] - pz[v[0]];
+				sx = 0.5 * (uy * wz - uz * wy);
+				sy = 0.5 * (uz * wx - ux * wz);
+				sz = 0.5 * (ux * wy - uy * wx);
+			}
+			else {
+				double nsx = 0.0, nsy = 0.0, nsz = 0.0;
+				double sum_a = 0.0, ax = 0.0, ay = 0.0, az = 0.0;
+				for (size_t j = 0; j < n; ++j) {
+					size_t a = v[j];
+					size_t b = v[j + 1 == n ? 0 : j + 1];
+					double ux = px[b] - px[a], uy = py[b] - py[a], uz = pz[b] - pz[a];
+					double wx = ex - px[a], wy = ey - py[a], wz = ez - pz[a];
+					double tx = uy * wz - uz * wy;
+					double ty = uz * wx - ux * wz;
+					double tz = ux * wy - uy * wx;
+					double ta = std::sqrt(tx * tx + ty * ty + tz * tz);
+					nsx += tx;
+					nsy += ty;
+					nsz += tz;
+					sum_a += ta;
+					ax += ta * (px[a] + px[b] + ex);
+					ay += ta * (py[a] + py[b] + ey);
+					az += ta * (pz[a] + pz[b] + ez);
+				}
+				sx = 0.5 * nsx;
+				sy = 0.5 * nsy;
+				sz = 0.5 * nsz;
+				if (sum_a > 0.0) {
+					cx = ax / (3.0 * sum_a);
+					cy = ay / (3.0 * sum_a);
+					cz = az / (3.0 * sum_a);
+				}
+			}
 
+			double area = std::sqrt(sx * sx + sy * sy + sz * sz);
+			double inv_area = area > 0.0 ? 1.0 / area : 0.0;
+			out.cx[f] = cx;
+			out.cy[f] = cy;
+			out.cz[f] = cz;
+			out.nx[f] = sx * inv_area;
+			out.ny[f] = sy * inv_area;
+			out.nz[f] = sz * inv_area;
+			out.area[f] = area;
+		}
+	}
 
+	face_geometry compute_face_geometry(const mesh& msh) {
 
+		size_t n = msh.f2v.size();
+		face_geometry geometry;
+		geometry.resize(n);
+		point_soa points = make_point_soa(msh.pos);
 
+		// triangles, quads and other polygons go through their own kernels
+		auto by_size = invert_rows<size_t>(n, 3, [&](size_t f) {
+			size_t k = msh.f2v[f].size();
+			return std::array<size_t, 1>{ k == 3 ? size_t{ 0 } : k == 4 ? size_t{ 1 } : size_t{ 2 } };
+			});
+		const auto& sizes = by_size;
+		auto run = [&](size_t group, auto kernel) {
+			auto faces = sizes[group];
+			parallel_for(0, faces.size(), [&](size_t i0, size_t i1) {
+				kernel(points, msh.f2v, faces.data() + i0, i1 - i0, geometry);
+				});
+			};
+		run(0, polygon_geometry<3>);
+		run(1, polygon_geometry<4>);
+		run(2, polygon_geometry<0>);
+		return geometry;
+	}
 
+	// every cell is cut into pyramids from its faces to the average of its
+	// face centres; faces point out of f2c[f][0] and into the other cell
+	cell_geometry compute_cell_geometry(const mesh& msh, const face_geometry& faces) {
+
+		const auto& c2f = msh.c2f();
+		size_t n = c2f.size();
+		cell_geometry geometry;
+		geometry.resize(n);
+
+		parallel_for(0, n, [&](size_t c0, size_t c1) {
+			for (size_t c = c0; c < c1; ++c) {
+				auto cell_faces = c2f[c];
+				double ex = 0.0, ey = 0.0, ez = 0.0;
+				for (auto f : cell_faces) {
+					ex += faces.cx[f];
+					ey += faces.cy[f];
+					ez += faces.cz[f];
+				}
+				double inv = cell_faces.empty() ? 0.0 : 1.0 / static_cast<double>(cell_faces.size());
+				ex *= inv;
+				ey *= inv;
+				ez *= inv;
+
+				double volume3 = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+				for (auto f : cell_faces) {
+					double sign = msh.f2c[f][0] == c ? 1.0 : -1.0;
+					double a = sign * faces.area[f];
+					double dx = faces.cx[f] - ex, dy = faces.cy[f] - ey, dz = faces.cz[f] - ez;
+					double pyramid3 = a * (faces.nx[f] * dx + faces.ny[f] * dy + faces.nz[f] * dz);
+					volume3 += pyramid3;
+					cx += pyramid3 * (0.75 * faces.cx[f] + 0.25 * ex);
+					cy += pyramid3 * (0.75 * faces.cy[f] + 0.25 * ey);
+					cz += pyramid3 * (0.75 * faces.cz[f] + 0.25 * ez);
+				}
+				geometry.volume[c] = volume3 / 3.0;
+				if (std::abs(volume3) > 0.0) {
+					geometry.cx[c] = cx / volume3;
+					geometry.cy[c] = cy / volume3;
+					geometry.cz[c] = cz / volume3;
+				}
+				else {
+					geometry.cx[c] = ex;
+					geometry.cy[c] = ey;
+					geometry.cz[c] = ez;
+				}
+			}
+			});
+		return geometry;
+	}
 
-		return msh;
+	cell_geometry compute_cell_geometry(const mesh& msh) {
+		return compute_cell_geometry(msh, compute_face_geometry(msh));
 	}
 
 